@@ -1,14 +1,208 @@
+#include <string.h>
+
+#include <algorithm>
+
 #include "apu.hpp"
 #include "cpu.hpp"
+#include "frontend.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+// NTSC CPU clock
+const double CpuClock = 1789773.0;
+
+// cycles from the start of the frame counter sequence, in 4 and 5 step
+// modes, the last one is the length of the sequence
+const int FrameSteps[2][6] = {
+    { 7457, 14913, 22371, 29829, 29830, 0 },
+    { 7457, 14913, 22371, 29829, 37281, 37282 }
+};
+
+// the audio is given to the frontend about once per frame
+const int DeliverCycles = 29830;
+
+const uint8_t LengthTable[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+const uint8_t DutyTable[4][8] = {
+    { 0, 1, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 1, 1, 0, 0, 0 },
+    { 1, 0, 0, 1, 1, 1, 1, 1 }
+};
+
+const uint8_t TriangleTable[32] = {
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// in CPU cycles
+const uint16_t NoisePeriods[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+const uint16_t DMCPeriods[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// linear approximation of the mixer, per unit of each channel
+const float PulseWeight = 0.00752f;
+const float TriangleWeight = 0.00851f;
+const float NoiseWeight = 0.00494f;
+const float DMCWeight = 0.00335f;
+
+}
+
+void APU::Envelope::clock()
+{
+    if ( start ) {
+        start = 0;
+        decay = 15;
+        divider = volume;
+    }
+    else if ( divider > 0 ) {
+        divider--;
+    }
+    else {
+        divider = volume;
+        if ( decay > 0 ) {
+            decay--;
+        }
+        else if ( loop ) {
+            decay = 15;
+        }
+    }
+}
+
+int APU::Pulse::sweepTarget() const
+{
+    int change = timer >> sweepShift;
+    if ( sweepNegate ) {
+        return timer - change - onesComplement;
+    }
+    return timer + change;
+}
+
+void APU::Pulse::clockSweep()
+{
+    if ( sweepDivider == 0 && sweepEnabled && sweepShift > 0 && !muted() ) {
+        timer = sweepTarget();
+    }
+    if ( sweepDivider == 0 || sweepReload ) {
+        sweepDivider = sweepPeriod;
+        sweepReload = 0;
+    }
+    else {
+        sweepDivider--;
+    }
+}
+
+int APU::Pulse::level() const
+{
+    if ( length == 0 || muted() || !DutyTable[duty][sequence] ) {
+        return 0;
+    }
+    return envelope.output();
+}
+
+void APU::Triangle::clockLinear()
+{
+    if ( reloadFlag ) {
+        linearCounter = linearReload;
+    }
+    else if ( linearCounter > 0 ) {
+        linearCounter--;
+    }
+    if ( !control ) {
+        reloadFlag = 0;
+    }
+}
+
+int APU::Noise::level() const
+{
+    if ( length == 0 || (shift & 1) ) {
+        return 0;
+    }
+    return envelope.output();
+}
+
+APU::APU( CPU* cpu, Controller* controller, Frontend* frontend ) : cpu_( cpu ),
+                                                                   controller_( controller ),
+                                                                   frontend_( frontend ),
+                                                                   time_( 0 ),
+                                                                   frameStart_( 0 ),
+                                                                   frameStep_( 0 ),
+                                                                   fiveStep_( false ),
+                                                                   irqInhibit_( false ),
+                                                                   frameIrq_( false ),
+                                                                   nextEvent_( 0 ),
+                                                                   noiseJumpSteps_( 0 ),
+                                                                   noiseJumpMode_( 0 ),
+                                                                   audio_( true ),
+                                                                   buffer_( CpuClock, 48000, 48000 / 20 ),
+                                                                   bufferStart_( 0 ),
+                                                                   samples_( 48000 / 20 )
+{
+    memset( pulse_, 0, sizeof(pulse_) );
+    memset( &triangle_, 0, sizeof(triangle_) );
+    memset( &noise_, 0, sizeof(noise_) );
+    memset( &dmc_, 0, sizeof(dmc_) );
+    pulse_[0].onesComplement = 1;
+    noise_.shift = 1;
+    dmc_.bufferEmpty = 1;
+    dmc_.bits = 8;
+    dmc_.silence = 1;
+    updateNextEvent();
+}
 
-APU::APU( CPU* cpu, Controller* controller ) : cpu_(cpu), controller_(controller) {}
 APU::~APU() {}
 
+void APU::setSampleRate( int rate )
+{
+    buffer_ = BandLimitedBuffer( CpuClock, rate, rate / 20 );
+    samples_.resize( rate / 20 );
+    bufferStart_ = time_;
+}
+
+void APU::setAudio( bool enabled )
+{
+    if ( enabled && !audio_ && time_ != bufferStart_ ) {
+        // time went on without sound, the pending steps are out of date
+        dropAudio();
+    }
+    audio_ = enabled;
+}
+
+void APU::setRateRatio( double ratio )
+{
+    buffer_.setRateRatio( std::max( 0.995, std::min( 1.005, ratio ) ) );
+}
+
 uint8_t APU::read( uint16_t addr ) const
 {
     if ( addr == 0x14 ) {
-        printf("DMA reading\n");
-        throw OutOfBoundAddress();
+        // write only
+        cpu_->raise( Fault::BadAddress, 0x4000 + addr );
+        return 0;
+    }
+    if ( addr == 0x15 ) {
+        // the status depends on the length counters
+        const_cast<APU*>( this )->sync();
+        uint8_t v = (pulse_[0].length > 0 ? 0x01 : 0) |
+            (pulse_[1].length > 0 ? 0x02 : 0) |
+            (triangle_.length > 0 ? 0x04 : 0) |
+            (noise_.length > 0 ? 0x08 : 0) |
+            (dmc_.remaining > 0 ? 0x10 : 0) |
+            (frameIrq_ ? 0x40 : 0) |
+            (dmc_.irq ? 0x80 : 0);
+        frameIrq_ = false;
+        updateIrq();
+        updateNextEvent();
+        return v;
     }
     if ( addr == 0x16 ) {
         return controller_->readPressed( 0 ) ? 1 : 0;
@@ -17,8 +211,8 @@ uint8_t APU::read( uint16_t addr ) const
         return controller_->readPressed( 1 ) ? 1 : 0;
     }
     if ( addr > 0x17 ) {
-        printf("Trying to read APU register #%x\n", addr );
-        throw OutOfBoundAddress();
+        // test registers, disabled
+        cpu_->raise( Fault::BadAddress, 0x4000 + addr );
     }
     return 0;
 }
@@ -27,13 +221,483 @@ void APU::write( uint16_t addr, uint8_t val )
 {
     if ( addr == 0x14 ) {
         cpu_->doDMA( val << 8 );
+        return;
     }
     else if ( addr == 0x16 ) {
         controller_->setStrobe( val & 1 );
         return;
     }
     else if ( addr > 0x17 ) {
-        printf("Trying to write APU register #%x\n", addr );
-        throw OutOfBoundAddress();
+        cpu_->raise( Fault::BadAddress, 0x4000 + addr );
+        return;
+    }
+
+    // the channels run with the old values up to now
+    sync();
+
+    switch ( addr ) {
+    case 0x00:
+    case 0x04: {
+        Pulse& p = pulse_[addr >> 2];
+        p.duty = val >> 6;
+        p.envelope.loop = (val >> 5) & 1;
+        p.envelope.constant = (val >> 4) & 1;
+        p.envelope.volume = val & 15;
+        break;
+    }
+    case 0x01:
+    case 0x05: {
+        Pulse& p = pulse_[addr >> 2];
+        p.sweepEnabled = val >> 7;
+        p.sweepPeriod = (val >> 4) & 7;
+        p.sweepNegate = (val >> 3) & 1;
+        p.sweepShift = val & 7;
+        p.sweepReload = 1;
+        break;
+    }
+    case 0x02:
+    case 0x06: {
+        Pulse& p = pulse_[addr >> 2];
+        p.timer = (p.timer & 0x700) | val;
+        break;
+    }
+    case 0x03:
+    case 0x07: {
+        Pulse& p = pulse_[addr >> 2];
+        p.timer = (p.timer & 0xFF) | ((val & 7) << 8);
+        if ( p.enabled ) {
+            p.length = LengthTable[val >> 3];
+        }
+        p.sequence = 0;
+        p.envelope.start = 1;
+        break;
+    }
+    case 0x08:
+        triangle_.control = val >> 7;
+        triangle_.linearReload = val & 0x7F;
+        break;
+    case 0x0A:
+        triangle_.timer = (triangle_.timer & 0x700) | val;
+        break;
+    case 0x0B:
+        triangle_.timer = (triangle_.timer & 0xFF) | ((val & 7) << 8);
+        if ( triangle_.enabled ) {
+            triangle_.length = LengthTable[val >> 3];
+        }
+        triangle_.reloadFlag = 1;
+        break;
+    case 0x0C:
+        noise_.envelope.loop = (val >> 5) & 1;
+        noise_.envelope.constant = (val >> 4) & 1;
+        noise_.envelope.volume = val & 15;
+        break;
+    case 0x0E:
+        noise_.mode = val >> 7;
+        noise_.period = val & 15;
+        break;
+    case 0x0F:
+        if ( noise_.enabled ) {
+            noise_.length = LengthTable[val >> 3];
+        }
+        noise_.envelope.start = 1;
+        break;
+    case 0x10:
+        dmc_.irqEnabled = val >> 7;
+        if ( !dmc_.irqEnabled ) {
+            dmc_.irq = 0;
+        }
+        dmc_.loop = (val >> 6) & 1;
+        dmc_.rate = val & 15;
+        break;
+    case 0x11:
+        dmc_.level = val & 0x7F;
+        step( dmc_.out, dmc_.level, time_, DMCWeight );
+        break;
+    case 0x12:
+        dmc_.sampleAddr = 0xC000 + val * 64;
+        break;
+    case 0x13:
+        dmc_.sampleLength = val * 16 + 1;
+        break;
+    case 0x15:
+        pulse_[0].enabled = val & 1;
+        pulse_[1].enabled = (val >> 1) & 1;
+        triangle_.enabled = (val >> 2) & 1;
+        noise_.enabled = (val >> 3) & 1;
+        for ( int i = 0; i < 2; i++ ) {
+            if ( !pulse_[i].enabled ) {
+                pulse_[i].length = 0;
+            }
+        }
+        if ( !triangle_.enabled ) {
+            triangle_.length = 0;
+        }
+        if ( !noise_.enabled ) {
+            noise_.length = 0;
+        }
+        dmc_.irq = 0;
+        if ( !(val & 0x10) ) {
+            dmc_.remaining = 0;
+        }
+        else if ( dmc_.remaining == 0 ) {
+            dmc_.addr = dmc_.sampleAddr;
+            dmc_.remaining = dmc_.sampleLength;
+            fetchSample();
+        }
+        break;
+    case 0x17:
+        fiveStep_ = val >> 7;
+        irqInhibit_ = (val >> 6) & 1;
+        if ( irqInhibit_ ) {
+            frameIrq_ = false;
+        }
+        // the sequence restarts a few cycles after the write
+        frameStart_ = time_ + 3;
+        frameStep_ = 0;
+        if ( fiveStep_ ) {
+            quarterFrame();
+            halfFrame();
+        }
+        break;
+    }
+    // $4010, $4015 and $4017 acknowledge interrupts
+    updateIrq();
+    updateNextEvent();
+}
+
+void APU::sync()
+{
+    NES_TRACE_SCOPE( Apu );
+    uint64_t target = cpu_->cycleCount;
+    while ( time_ < target ) {
+        // the channels do not change between two frame counter clocks
+        uint64_t next = std::min( target, nextFrameEvent() );
+        runPulse( pulse_[0], next );
+        runPulse( pulse_[1], next );
+        runTriangle( next );
+        runNoise( next );
+        runDMC( next );
+        time_ = next;
+        if ( time_ == nextFrameEvent() ) {
+            clockFrameCounter();
+            if ( time_ - bufferStart_ >= uint64_t( DeliverCycles ) ) {
+                deliver();
+            }
+        }
     }
+    updateIrq();
+    updateNextEvent();
+}
+
+void APU::flush()
+{
+    sync();
+    deliver();
+}
+
+void APU::deliver()
+{
+    if ( !audio_ ) {
+        // nothing added, the pending step tails are left for when the
+        // sound comes back
+        return;
+    }
+    buffer_.endFrame( uint32_t( time_ - bufferStart_ ) );
+    bufferStart_ = time_;
+    size_t n = buffer_.read( &samples_[0], samples_.size() );
+    if ( frontend_ && n ) {
+        frontend_->playAudio( &samples_[0], n );
+    }
+}
+
+uint64_t APU::nextFrameEvent() const
+{
+    return frameStart_ + FrameSteps[fiveStep_][frameStep_];
+}
+
+void APU::updateIrq() const
+{
+    cpu_->setIRQ( CPU::IrqApu, frameIrq_ || dmc_.irq );
+}
+
+void APU::updateNextEvent() const
+{
+    nextEvent_ = UINT64_MAX;
+    // the frame interrupt is raised on a clock of the four-step sequence
+    if ( !fiveStep_ && !irqInhibit_ && !frameIrq_ ) {
+        nextEvent_ = nextFrameEvent();
+    }
+    // the DMC one when the last byte is fetched, after a whole shift
+    // register has been played
+    if ( dmc_.irqEnabled && !dmc_.loop && !dmc_.irq && dmc_.remaining > 0 ) {
+        uint64_t fetch = time_ + dmc_.delay + uint64_t( dmc_.bits - 1 ) * DMCPeriods[dmc_.rate];
+        nextEvent_ = std::min( nextEvent_, fetch + 1 );
+    }
+}
+
+void APU::clockFrameCounter()
+{
+    if ( !fiveStep_ ) {
+        switch ( frameStep_ ) {
+        case 0:
+        case 2:
+            quarterFrame();
+            break;
+        case 1:
+            quarterFrame();
+            halfFrame();
+            break;
+        case 3:
+            quarterFrame();
+            halfFrame();
+            if ( !irqInhibit_ ) {
+                frameIrq_ = true;
+            }
+            break;
+        }
+        frameStep_++;
+        if ( frameStep_ == 5 ) {
+            frameStart_ += FrameSteps[0][4];
+            frameStep_ = 0;
+        }
+    }
+    else {
+        switch ( frameStep_ ) {
+        case 0:
+        case 2:
+            quarterFrame();
+            break;
+        case 1:
+        case 4:
+            quarterFrame();
+            halfFrame();
+            break;
+        }
+        frameStep_++;
+        if ( frameStep_ == 6 ) {
+            frameStart_ += FrameSteps[1][5];
+            frameStep_ = 0;
+        }
+    }
+}
+
+void APU::quarterFrame()
+{
+    pulse_[0].envelope.clock();
+    pulse_[1].envelope.clock();
+    noise_.envelope.clock();
+    triangle_.clockLinear();
+}
+
+void APU::halfFrame()
+{
+    for ( int i = 0; i < 2; i++ ) {
+        Pulse& p = pulse_[i];
+        if ( p.length > 0 && !p.envelope.loop ) {
+            p.length--;
+        }
+        p.clockSweep();
+    }
+    if ( triangle_.length > 0 && !triangle_.control ) {
+        triangle_.length--;
+    }
+    if ( noise_.length > 0 && !noise_.envelope.loop ) {
+        noise_.length--;
+    }
+}
+
+void APU::runPulse( Pulse& p, uint64_t t )
+{
+    // the volume may have changed since the last run
+    step( p.out, p.level(), time_, PulseWeight );
+
+    // the timer is clocked every other cycle
+    int period = (p.timer + 1) * 2;
+    uint64_t next = time_ + p.delay;
+    if ( next < t ) {
+        if ( p.length == 0 || p.muted() || p.envelope.output() == 0 ) {
+            // silent, only the position in the sequence matters
+            uint64_t n = (t - next + period - 1) / period;
+            p.sequence = (p.sequence - n) & 7;
+            next += n * period;
+        }
+        else {
+            for ( ; next < t; next += period ) {
+                p.sequence = (p.sequence - 1) & 7;
+                step( p.out, p.level(), next, PulseWeight );
+            }
+        }
+    }
+    p.delay = int32_t( next - t );
+}
+
+void APU::runTriangle( uint64_t t )
+{
+    step( triangle_.out, TriangleTable[triangle_.sequence], time_, TriangleWeight );
+
+    int period = triangle_.timer + 1;
+    uint64_t next = time_ + triangle_.delay;
+    if ( next < t ) {
+        uint64_t n = (t - next + period - 1) / period;
+        // the sequencer is halted by the counters, and ultrasonic
+        // periods are not played (the output would average to 7.5)
+        if ( triangle_.length > 0 && triangle_.linearCounter > 0 && triangle_.timer >= 2 ) {
+            for ( ; next < t; next += period ) {
+                triangle_.sequence = (triangle_.sequence + 1) & 31;
+                step( triangle_.out, TriangleTable[triangle_.sequence], next, TriangleWeight );
+            }
+        }
+        else {
+            next += n * period;
+        }
+    }
+    triangle_.delay = int32_t( next - t );
+}
+
+void APU::runNoise( uint64_t t )
+{
+    step( noise_.out, noise_.level(), time_, NoiseWeight );
+
+    int period = NoisePeriods[noise_.period];
+    uint64_t next = time_ + noise_.delay;
+    if ( next < t ) {
+        if ( noise_.length == 0 || noise_.envelope.output() == 0 ) {
+            // the shift register is not clocked while silent, nobody
+            // can tell
+            uint64_t n = (t - next + period - 1) / period;
+            next += n * period;
+        }
+        else {
+            int tap = noise_.mode ? 6 : 1;
+            // above the sample rate, the level is only reported about
+            // once per sample
+            uint64_t every = std::max( 1, buffer_.clocksPerSample() / period );
+            uint64_t n = (t - next + period - 1) / period;
+            if ( every > 1 && (noiseJumpSteps_ != int( every ) || noiseJumpMode_ != noise_.mode) ) {
+                buildNoiseJump( noise_.mode, int( every ) );
+            }
+            while ( n > 0 ) {
+                int k = int( std::min( every, n ) );
+                uint16_t shift = noise_.shift;
+                if ( k > 1 && k == noiseJumpSteps_ ) {
+                    shift = noiseJump_[0][shift & 0xFF] ^ noiseJump_[1][shift >> 8];
+                }
+                else {
+                    for ( int i = 0; i < k; i++ ) {
+                        uint16_t feedback = (shift ^ (shift >> tap)) & 1;
+                        shift = (shift >> 1) | (feedback << 14);
+                    }
+                }
+                noise_.shift = shift;
+                n -= k;
+                next += k * period;
+                step( noise_.out, noise_.level(), next - period, NoiseWeight );
+            }
+        }
+    }
+    noise_.delay = int32_t( next - t );
+}
+
+void APU::buildNoiseJump( int mode, int steps )
+{
+    // the shift register is linear: the state after n steps is the XOR of
+    // the states reached from each of its bits
+    int tap = mode ? 6 : 1;
+    for ( int half = 0; half < 2; half++ ) {
+        for ( int b = 0; b < 256; b++ ) {
+            uint16_t shift = b << (half * 8);
+            for ( int i = 0; i < steps; i++ ) {
+                uint16_t feedback = (shift ^ (shift >> tap)) & 1;
+                shift = (shift >> 1) | (feedback << 14);
+            }
+            noiseJump_[half][b] = shift;
+        }
+    }
+    noiseJumpSteps_ = steps;
+    noiseJumpMode_ = mode;
+}
+
+void APU::runDMC( uint64_t t )
+{
+    int period = DMCPeriods[dmc_.rate];
+    uint64_t next = time_ + dmc_.delay;
+    for ( ; next < t; next += period ) {
+        if ( !dmc_.silence ) {
+            if ( dmc_.shift & 1 ) {
+                if ( dmc_.level <= 125 ) {
+                    dmc_.level += 2;
+                }
+            }
+            else if ( dmc_.level >= 2 ) {
+                dmc_.level -= 2;
+            }
+            step( dmc_.out, dmc_.level, next, DMCWeight );
+        }
+        dmc_.shift >>= 1;
+        if ( --dmc_.bits == 0 ) {
+            dmc_.bits = 8;
+            dmc_.silence = dmc_.bufferEmpty;
+            if ( !dmc_.bufferEmpty ) {
+                dmc_.shift = dmc_.buffer;
+                dmc_.bufferEmpty = 1;
+                fetchSample();
+            }
+        }
+    }
+    dmc_.delay = int32_t( next - t );
+}
+
+void APU::fetchSample()
+{
+    if ( !dmc_.bufferEmpty || dmc_.remaining == 0 ) {
+        return;
+    }
+    // the CPU stall is not emulated
+    dmc_.buffer = cpu_->readMem8( dmc_.addr, true );
+    dmc_.bufferEmpty = 0;
+    dmc_.addr = dmc_.addr == 0xFFFF ? 0x8000 : dmc_.addr + 1;
+    if ( --dmc_.remaining == 0 ) {
+        if ( dmc_.loop ) {
+            dmc_.addr = dmc_.sampleAddr;
+            dmc_.remaining = dmc_.sampleLength;
+        }
+        else if ( dmc_.irqEnabled ) {
+            dmc_.irq = 1;
+        }
+    }
+}
+
+void APU::saveState( State& state ) const
+{
+    memcpy( state.pulse, pulse_, sizeof(state.pulse) );
+    state.triangle = triangle_;
+    state.noise = noise_;
+    state.dmc = dmc_;
+    state.time = time_;
+    state.frameStart = frameStart_;
+    state.frameStep = frameStep_;
+    state.fiveStep = fiveStep_;
+    state.irqInhibit = irqInhibit_;
+    state.frameIrq = frameIrq_;
+}
+
+void APU::loadState( const State& state )
+{
+    memcpy( pulse_, state.pulse, sizeof(pulse_) );
+    triangle_ = state.triangle;
+    noise_ = state.noise;
+    dmc_ = state.dmc;
+    time_ = state.time;
+    frameStart_ = state.frameStart;
+    frameStep_ = state.frameStep;
+    fiveStep_ = state.fiveStep;
+    irqInhibit_ = state.irqInhibit;
+    frameIrq_ = state.frameIrq;
+    updateNextEvent();
+}
+
+void APU::dropAudio()
+{
+    buffer_.clear();
+    bufferStart_ = time_;
 }
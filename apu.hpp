@@ -1,20 +1,235 @@
+#ifndef NES_APU_HPP
+#define NES_APU_HPP
+
 #include <vector>
-#include "SDL.h"
 #include "bus_device.hpp"
+#include "band_limited.hpp"
 #include "controller.hpp"
 
 class CPU;
+class Frontend;
 
+///
+/// Audio processing unit: two pulse channels, a triangle, a noise and a
+/// delta modulation (DMC) channel, sequenced by the frame counter
+///
+/// Like the PPU, the APU is left idle while the CPU runs. It catches up
+/// with the CPU time when one of its registers is accessed, when it may
+/// raise an interrupt (nextEvent) and when the audio of a frame is
+/// flushed. The channels are not clocked cycle by
+/// cycle: each one jumps from one change of its output to the next and
+/// reports the changes to a band-limited buffer.
+///
+/// The channels are mixed linearly.
 class APU : public BusDevice
 {
  public:
-    APU( CPU* cpu, Controller* ctrl );
+    APU( CPU* cpu, Controller* ctrl, Frontend* frontend );
     virtual ~APU();
 
     uint8_t read( uint16_t addr ) const;
     void write( uint16_t addr, uint8_t val );
 
+    // advance to the current CPU time
+    void sync();
+    // sync and give the samples produced so far to the frontend
+    void flush();
+    // CPU cycle from which the frame counter or the DMC may raise an
+    // interrupt: the APU is to be synced once the CPU gets there
+    uint64_t nextEvent() const { return nextEvent_; }
+
+    // When disabled, the channels run but no sound is synthesized, and
+    // the samples pending in the buffer are kept as they are
+    // (run-ahead restores the time they stopped at before enabling again)
+    void setAudio( bool enabled );
+    bool audio() const { return audio_; }
+
+    int sampleRate() const { return buffer_.sampleRate(); }
+    // forgets the samples not flushed yet
+    void setSampleRate( int rate );
+    // dynamic rate control: ratio of samples produced to the sample rate,
+    // within half a percent
+    void setRateRatio( double ratio );
+
+    // Channels, plain data to be part of the saved state
+
+    struct Envelope
+    {
+        uint8_t start;
+        uint8_t loop;
+        uint8_t constant;
+        uint8_t volume;
+        uint8_t divider;
+        uint8_t decay;
+
+        void clock();
+        int output() const { return constant ? volume : decay; }
+    };
+
+    struct Pulse
+    {
+        Envelope envelope;
+        // by the status register, the length counter stays at 0 if not
+        uint8_t enabled;
+        uint8_t duty;
+        uint8_t sequence;
+        uint8_t length;
+        uint8_t sweepEnabled;
+        uint8_t sweepPeriod;
+        uint8_t sweepNegate;
+        uint8_t sweepShift;
+        uint8_t sweepReload;
+        uint8_t sweepDivider;
+        // pulse 1 negates in ones' complement
+        uint8_t onesComplement;
+        uint16_t timer;
+        // CPU cycles until the next step of the sequencer
+        int32_t delay;
+        // level last given to the buffer
+        int32_t out;
+
+        int sweepTarget() const;
+        bool muted() const { return timer < 8 || sweepTarget() > 0x7FF; }
+        void clockSweep();
+        int level() const;
+    };
+
+    struct Triangle
+    {
+        uint8_t enabled;
+        uint8_t control;
+        uint8_t linearReload;
+        uint8_t linearCounter;
+        uint8_t reloadFlag;
+        uint8_t sequence;
+        uint8_t length;
+        uint16_t timer;
+        int32_t delay;
+        int32_t out;
+
+        void clockLinear();
+    };
+
+    struct Noise
+    {
+        Envelope envelope;
+        uint8_t enabled;
+        uint8_t mode;
+        uint8_t period;
+        uint8_t length;
+        uint16_t shift;
+        int32_t delay;
+        int32_t out;
+
+        int level() const;
+    };
+
+    struct DMC
+    {
+        uint8_t irqEnabled;
+        uint8_t irq;
+        uint8_t loop;
+        uint8_t rate;
+        uint8_t level;
+        uint8_t buffer;
+        uint8_t bufferEmpty;
+        uint8_t shift;
+        uint8_t bits;
+        uint8_t silence;
+        uint16_t sampleAddr;
+        uint16_t sampleLength;
+        uint16_t addr;
+        uint16_t remaining;
+        int32_t delay;
+        int32_t out;
+    };
+
+    // Saved state, the samples not flushed yet are not part of it
+    struct State
+    {
+        Pulse pulse[2];
+        Triangle triangle;
+        Noise noise;
+        DMC dmc;
+        uint64_t time;
+        uint64_t frameStart;
+        int32_t frameStep;
+        uint8_t fiveStep;
+        uint8_t irqInhibit;
+        uint8_t frameIrq;
+    };
+    void saveState( State& state ) const;
+    // the samples pending are kept, see dropAudio
+    void loadState( const State& state );
+    // forget the samples not delivered yet, after a jump in time (rewind,
+    // state load)
+    void dropAudio();
+
  private:
     CPU* cpu_;
     Controller* controller_;
+    Frontend* frontend_;
+
+    Pulse pulse_[2];
+    Triangle triangle_;
+    Noise noise_;
+    DMC dmc_;
+
+    // CPU cycle the channels have been run to
+    uint64_t time_;
+
+    // Frame counter: quarter and half frame clocks at fixed cycles from
+    // the start of its sequence
+    uint64_t frameStart_;
+    int frameStep_;
+    bool fiveStep_;
+    bool irqInhibit_;
+    // mutable: cleared by reading the status
+    mutable bool frameIrq_;
+    // see nextEvent, mutable: rescheduled by reading the status
+    mutable uint64_t nextEvent_;
+
+    uint64_t nextFrameEvent() const;
+    void clockFrameCounter();
+    void quarterFrame();
+    void halfFrame();
+    // the CPU IRQ line follows the frame and DMC interrupt flags
+    void updateIrq() const;
+    void updateNextEvent() const;
+
+    // run the channels from time_ to t
+    void runPulse( Pulse& p, uint64_t t );
+    void runTriangle( uint64_t t );
+    void runNoise( uint64_t t );
+    void runDMC( uint64_t t );
+    void fetchSample();
+
+    // state of the noise shift register after noiseJumpSteps_ steps,
+    // from its low and high bytes
+    uint16_t noiseJump_[2][256];
+    int noiseJumpSteps_;
+    int noiseJumpMode_;
+    void buildNoiseJump( int mode, int steps );
+
+    // output of a channel changing to level at time t
+    void step( int32_t& out, int level, uint64_t t, float weight )
+    {
+        if ( level != out ) {
+            if ( audio_ ) {
+                buffer_.addDelta( uint32_t( t - bufferStart_ ), (level - out) * weight );
+            }
+            out = level;
+        }
+    }
+
+    // end the buffer frame and give its samples to the frontend
+    void deliver();
+
+    bool audio_;
+    BandLimitedBuffer buffer_;
+    // CPU cycle of the start of the buffer frame
+    uint64_t bufferStart_;
+    std::vector<int16_t> samples_;
 };
+
+#endif
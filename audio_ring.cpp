@@ -0,0 +1,47 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "audio_ring.hpp"
+
+AudioRing::AudioRing( size_t capacity ) : written_( 0 ),
+                                          read_( 0 )
+{
+    size_t size = 1;
+    while ( size < capacity ) {
+        size <<= 1;
+    }
+    buffer_.resize( size );
+    mask_ = size - 1;
+}
+
+size_t AudioRing::write( const int16_t* samples, size_t n )
+{
+    size_t w = written_.load( std::memory_order_relaxed );
+    size_t r = read_.load( std::memory_order_acquire );
+    n = std::min( n, buffer_.size() - (w - r) );
+
+    // in two parts when wrapping around
+    size_t pos = w & mask_;
+    size_t first = std::min( n, buffer_.size() - pos );
+    memcpy( &buffer_[pos], samples, first * sizeof(int16_t) );
+    memcpy( &buffer_[0], samples + first, (n - first) * sizeof(int16_t) );
+
+    written_.store( w + n, std::memory_order_release );
+    return n;
+}
+
+size_t AudioRing::read( int16_t* samples, size_t n )
+{
+    size_t r = read_.load( std::memory_order_relaxed );
+    size_t w = written_.load( std::memory_order_acquire );
+    n = std::min( n, w - r );
+
+    size_t pos = r & mask_;
+    size_t first = std::min( n, buffer_.size() - pos );
+    memcpy( samples, &buffer_[pos], first * sizeof(int16_t) );
+    memcpy( samples + first, &buffer_[0], (n - first) * sizeof(int16_t) );
+
+    read_.store( r + n, std::memory_order_release );
+    return n;
+}
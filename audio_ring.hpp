@@ -0,0 +1,47 @@
+#ifndef NES_AUDIO_RING_HPP
+#define NES_AUDIO_RING_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+///
+/// Ring buffer of audio samples between the emulation thread, which
+/// writes, and the audio callback, which reads
+///
+/// Single producer, single consumer, without locks: the producer only
+/// moves the write position and the consumer the read position, the
+/// samples are published by the release store of the position.
+class AudioRing
+{
+public:
+    /// capacity is rounded up to a power of two
+    AudioRing( size_t capacity );
+
+    size_t capacity() const { return buffer_.size(); }
+
+    /// Samples waiting to be read: the other side can only make it
+    /// smaller for the producer, larger for the consumer
+    size_t size() const
+    {
+        return written_.load( std::memory_order_acquire ) - read_.load( std::memory_order_acquire );
+    }
+
+    /// Producer side: copy at most n samples, returns how many fit
+    size_t write( const int16_t* samples, size_t n );
+
+    /// Consumer side: copy at most n samples, returns how many were there
+    size_t read( int16_t* samples, size_t n );
+
+private:
+    std::vector<int16_t> buffer_;
+    size_t mask_;
+
+    // positions since the start, on separate cache lines
+    alignas(64) std::atomic<size_t> written_;
+    alignas(64) std::atomic<size_t> read_;
+};
+
+#endif
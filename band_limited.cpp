@@ -0,0 +1,76 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "band_limited.hpp"
+
+BandLimitedBuffer::BandLimitedBuffer( double clockRate, int sampleRate, int maxSamples ) :
+    clockRate_( clockRate ),
+    sampleRate_( sampleRate ),
+    factor_( uint64_t( sampleRate / clockRate * 4294967296.0 ) ),
+    offset_( 0 ),
+    deltas_( maxSamples + Width + 1 ),
+    avail_( 0 ),
+    level_( 0 ),
+    lastLevel_( 0 ),
+    highPass_( 0 ),
+    // 90 Hz, as the first filter of the NES output
+    highPassCoef_( float( exp( -2 * M_PI * 90.0 / sampleRate ) ) )
+{
+    // windowed sinc, centered between taps Width/2-1 and Width/2 with a
+    // cutoff a bit below the Nyquist frequency. Each phase is normalized
+    // so that a step always sums to its delta.
+    const double cutoff = 0.9;
+    for ( int p = 0; p < Phases; p++ ) {
+        double sum = 0;
+        for ( int i = 0; i < Width; i++ ) {
+            double x = i - (Width / 2 - 1) - double( p ) / Phases;
+            double s = x == 0 ? 1 : sin( M_PI * cutoff * x ) / (M_PI * cutoff * x);
+            double w = 0.42 + 0.5 * cos( 2 * M_PI * x / Width ) + 0.08 * cos( 4 * M_PI * x / Width );
+            kernel_[p][i] = float( s * w );
+            sum += s * w;
+        }
+        for ( int i = 0; i < Width; i++ ) {
+            kernel_[p][i] = float( kernel_[p][i] / sum );
+        }
+    }
+}
+
+void BandLimitedBuffer::setRateRatio( double ratio )
+{
+    factor_ = uint64_t( sampleRate_ * ratio / clockRate_ * 4294967296.0 );
+}
+
+void BandLimitedBuffer::endFrame( uint32_t clocks )
+{
+    uint64_t pos = clocks * factor_ + offset_;
+    avail_ += pos >> 32;
+    offset_ = pos & 0xFFFFFFFF;
+}
+
+size_t BandLimitedBuffer::read( int16_t* out, size_t n )
+{
+    n = std::min( n, avail_ );
+    for ( size_t i = 0; i < n; i++ ) {
+        level_ += deltas_[i];
+        highPass_ = highPassCoef_ * (highPass_ + level_ - lastLevel_);
+        lastLevel_ = level_;
+        float s = highPass_ * 32767.0f;
+        s = std::max( -32768.0f, std::min( 32767.0f, s ) );
+        out[i] = int16_t( s );
+    }
+    // the steps of the next samples are kept
+    memmove( &deltas_[0], &deltas_[n], (deltas_.size() - n) * sizeof(float) );
+    memset( &deltas_[deltas_.size() - n], 0, n * sizeof(float) );
+    avail_ -= n;
+    return n;
+}
+
+void BandLimitedBuffer::clear()
+{
+    // the level is kept to avoid a click
+    std::fill( deltas_.begin(), deltas_.end(), 0.0f );
+    avail_ = 0;
+    offset_ = 0;
+}
@@ -0,0 +1,103 @@
+#ifndef NES_BAND_LIMITED_HPP
+#define NES_BAND_LIMITED_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+///
+/// Band-limited synthesis of a signal made of steps
+///
+/// Instead of sampling the output of the sound channels on each clock,
+/// the channels only report when their level changes. Each change adds
+/// a band-limited step (the integral of a windowed sinc, at the right
+/// fraction of sample) to the buffer, so that the cost depends on the
+/// number of changes and not on the clock rate, without aliasing.
+///
+/// The buffer holds the differences between consecutive samples, which
+/// are summed when the samples are read.
+class BandLimitedBuffer
+{
+public:
+    // width of a step, in samples
+    static const int Width = 16;
+    // fractions of sample a step can start at
+    static const int Phases = 32;
+
+    /// clockRate: clocks per second of the times given to addDelta
+    /// maxSamples: samples that can be waiting to be read
+    BandLimitedBuffer( double clockRate, int sampleRate, int maxSamples );
+
+    int sampleRate() const { return sampleRate_; }
+
+    /// Produce ratio times more samples per clock than the sample rate,
+    /// to follow the actual speed of the audio output (ratio close to 1)
+    void setRateRatio( double ratio );
+
+    /// Step of delta at time clocks after the end of the last frame
+    void addDelta( uint32_t time, float delta )
+    {
+        uint64_t pos = time * factor_ + offset_;
+        const float* k = kernel_[ (pos >> (32 - PhaseBits)) & (Phases - 1) ];
+        float* out = &deltas_[ avail_ + (pos >> 32) ];
+#ifdef __SSE2__
+        __m128 d = _mm_set1_ps( delta );
+        for ( int i = 0; i < Width; i += 4 ) {
+            __m128 o = _mm_loadu_ps( out + i );
+            _mm_storeu_ps( out + i, _mm_add_ps( o, _mm_mul_ps( d, _mm_load_ps( k + i ) ) ) );
+        }
+#else
+        for ( int i = 0; i < Width; i++ ) {
+            out[i] += delta * k[i];
+        }
+#endif
+    }
+
+    /// Clocks per sample, rounded down
+    int clocksPerSample() const { return int( clockRate_ / sampleRate_ ); }
+
+    /// Close the frame of clocks clocks, its samples can be read
+    /// clocks must be less than the time of maxSamples samples.
+    void endFrame( uint32_t clocks );
+
+    /// Samples ready to be read
+    size_t available() const { return avail_; }
+
+    /// Move at most n samples to out (16-bit signed, high-pass filtered)
+    /// Returns the number of samples read
+    size_t read( int16_t* out, size_t n );
+
+    /// Forget the samples and the steps not read yet
+    void clear();
+
+private:
+    static const int PhaseBits = 5;
+
+    double clockRate_;
+    int sampleRate_;
+    // samples per clock, 32.32 fixed point
+    uint64_t factor_;
+    // fraction of sample at which the current frame starts
+    uint64_t offset_;
+
+    // differences between consecutive samples, the avail_ first ones are
+    // complete, the following ones still receive steps
+    std::vector<float> deltas_;
+    size_t avail_;
+
+    // running sum of deltas_ and state of the high-pass filter
+    float level_;
+    float lastLevel_;
+    float highPass_;
+    float highPassCoef_;
+
+    // aligned for SSE
+    float kernel_[Phases][Width] __attribute__((aligned(16)));
+};
+
+#endif
@@ -0,0 +1,162 @@
+// Runs many independent consoles on all the cores and reports the
+// aggregate emulation speed
+//
+// Each ROM given on the command line is run by --instances consoles for
+// --frames frames, without window nor input.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "console.hpp"
+#include "frontend.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+double now()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// One console running a ROM, a few frames per call
+class Instance : public ThreadPool::Task
+{
+public:
+    // frames run before giving the worker back
+    static const int Slice = 10;
+
+    Instance( const std::string& nesFile, int frames ) : nesFile_( nesFile ),
+                                                         frames_( frames ),
+                                                         done_( 0 ),
+                                                         console_( 0 )
+    {
+    }
+
+    ~Instance()
+    {
+        delete console_;
+    }
+
+    bool run()
+    {
+        try {
+            if ( !console_ ) {
+                // allocated by the worker that runs it
+                console_ = new Console( &frontend_ );
+                console_->load( nesFile_ );
+            }
+            for ( int i = 0; i < Slice && done_ < frames_; i++ ) {
+                console_->runFrame();
+                done_++;
+            }
+            if ( console_->cpu().stopped() ) {
+                std::ostringstream ostr;
+                ostr << console_->cpu().fault();
+                error_ = ostr.str();
+                finish();
+                return false;
+            }
+        }
+        catch ( std::exception& e ) {
+            error_ = e.what();
+            finish();
+            return false;
+        }
+        if ( done_ < frames_ ) {
+            return true;
+        }
+        finish();
+        return false;
+    }
+
+    const std::string& nesFile() const { return nesFile_; }
+    int frames() const { return done_; }
+    const std::string& error() const { return error_; }
+
+private:
+    void finish()
+    {
+        delete console_;
+        console_ = 0;
+    }
+
+    std::string nesFile_;
+    int frames_;
+    int done_;
+    std::string error_;
+    NullFrontend frontend_;
+    Console* console_;
+};
+
+}
+
+int main( int argc, char *argv[] )
+{
+    int threads = 0;
+    int frames = 600;
+    int instances = 1;
+    std::vector<std::string> files;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--threads" && i + 1 < argc ) {
+            threads = atoi( argv[++i] );
+        }
+        else if ( arg == "--frames" && i + 1 < argc ) {
+            frames = atoi( argv[++i] );
+        }
+        else if ( arg == "--instances" && i + 1 < argc ) {
+            instances = atoi( argv[++i] );
+        }
+        else {
+            files.push_back( arg );
+        }
+    }
+    if ( files.empty() ) {
+        std::cerr << "Arguments: [--threads n] [--frames n] [--instances n] nes_file..." << std::endl;
+        return 1;
+    }
+
+    std::vector<Instance*> all;
+    std::vector<ThreadPool::Task*> tasks;
+    for ( size_t f = 0; f < files.size(); f++ ) {
+        for ( int i = 0; i < instances; i++ ) {
+            all.push_back( new Instance( files[f], frames ) );
+            tasks.push_back( all.back() );
+        }
+    }
+
+    ThreadPool pool( threads );
+    double start = now();
+    pool.run( tasks );
+    double elapsed = now() - start;
+
+    long total = 0;
+    int failed = 0;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        total += all[i]->frames();
+        if ( !all[i]->error().empty() ) {
+            std::cerr << all[i]->nesFile() << ": " << all[i]->error() << std::endl;
+            failed++;
+        }
+        delete all[i];
+    }
+
+    printf( "instances %d threads %d frames %ld in %.2f s: %.0f fps (%.0f per thread)\n",
+            int( tasks.size() ), pool.size(), total, elapsed,
+            total / elapsed, total / elapsed / pool.size() );
+    if ( failed ) {
+        printf( "%d instances failed\n", failed );
+    }
+    return failed ? 1 : 0;
+}
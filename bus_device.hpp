@@ -1,17 +1,27 @@
 #ifndef JANE_BUS_DEVICE
 #define JANE_BUS_DEVICE
 
+#include <stdint.h>
+#include <stddef.h>
+
 ///
 /// BusDevice : a device plugged on the CPU buses
 /// Must have a method to read and a method to write
+/// They do not throw: the registers report bad accesses as CPU faults.
 class BusDevice
 {
 public:
     virtual uint8_t read( uint16_t addr ) const = 0;
     virtual void write( uint16_t addr, uint8_t val ) = 0;
 
-    // exception thrown by out-of-range address access
-    struct OutOfBoundAddress {};
+    ///
+    /// Direct access to the storage behind the device, if any.
+    /// Plain memories (RAM, ROM) return a pointer to the byte at addr and
+    /// set size to the number of bytes that follow it. Devices with
+    /// side effects (registers) return 0 and must go through read/write.
+    virtual uint8_t* storage( uint16_t, size_t& ) { return 0; }
+    /// true if writes can go straight to storage()
+    virtual bool writableStorage() const { return false; }
 };
 
 #endif
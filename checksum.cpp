@@ -0,0 +1,322 @@
+#include <string.h>
+
+#include "checksum.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+// slice by 8: table k gives the CRC of a byte followed by k zero bytes
+struct CrcTables
+{
+    uint32_t t[8][256];
+    CrcTables()
+    {
+        for ( int i = 0; i < 256; i++ ) {
+            uint32_t c = i;
+            for ( int k = 0; k < 8; k++ ) {
+                c = (c >> 1) ^ ((c & 1) ? 0xEDB88320 : 0);
+            }
+            t[0][i] = c;
+        }
+        for ( int i = 0; i < 256; i++ ) {
+            for ( int k = 1; k < 8; k++ ) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const CrcTables crcTables;
+
+// crc without the inversions at both ends
+uint32_t crcBytes( const uint8_t* p, size_t n, uint32_t c )
+{
+    const uint32_t (*t)[256] = crcTables.t;
+    for ( ; n >= 8; n -= 8, p += 8 ) {
+        uint32_t lo = c ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t( p[3] ) << 24));
+        uint32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) | (uint32_t( p[7] ) << 24);
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for ( ; n > 0; n--, p++ ) {
+        c = (c >> 8) ^ t[0][(c ^ *p) & 0xFF];
+    }
+    return c;
+}
+
+}
+
+uint32_t crc32SliceBy8( const uint8_t* data, size_t size, uint32_t crc )
+{
+    return ~crcBytes( data, size, ~crc );
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Folding of 4 x 128 bits at a time by carry-less multiplications, then
+// Barrett reduction to 32 bits (Intel, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction"), constants of the reflected
+// IEEE polynomial
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32Clmul( const uint8_t* data, size_t size, uint32_t crc )
+{
+    uint32_t c = ~crc;
+    if ( size < 64 ) {
+        return ~crcBytes( data, size, c );
+    }
+    const __m128i k1k2 = _mm_set_epi64x( 0x01c6e41596LL, 0x0154442bd4LL );
+    const __m128i k3k4 = _mm_set_epi64x( 0x00ccaa009eLL, 0x01751997d0LL );
+    const __m128i k5k0 = _mm_set_epi64x( 0, 0x0163cd6124LL );
+    const __m128i poly = _mm_set_epi64x( 0x01f7011641LL, 0x01db710641LL );
+    const __m128i mask32 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+
+    __m128i x[4];
+    for ( int i = 0; i < 4; i++ ) {
+        x[i] = _mm_loadu_si128( (const __m128i*)(data + i * 16) );
+    }
+    x[0] = _mm_xor_si128( x[0], _mm_cvtsi32_si128( c ) );
+    data += 64;
+    size -= 64;
+
+    for ( ; size >= 64; size -= 64, data += 64 ) {
+        for ( int i = 0; i < 4; i++ ) {
+            __m128i lo = _mm_clmulepi64_si128( x[i], k1k2, 0x00 );
+            __m128i hi = _mm_clmulepi64_si128( x[i], k1k2, 0x11 );
+            __m128i d = _mm_loadu_si128( (const __m128i*)(data + i * 16) );
+            x[i] = _mm_xor_si128( _mm_xor_si128( lo, hi ), d );
+        }
+    }
+
+    // 4 x 128 bits into 128 bits, then the remaining 16 bytes blocks
+    __m128i r = x[0];
+    for ( int i = 1; i < 4; i++ ) {
+        __m128i lo = _mm_clmulepi64_si128( r, k3k4, 0x00 );
+        __m128i hi = _mm_clmulepi64_si128( r, k3k4, 0x11 );
+        r = _mm_xor_si128( _mm_xor_si128( lo, hi ), x[i] );
+    }
+    for ( ; size >= 16; size -= 16, data += 16 ) {
+        __m128i lo = _mm_clmulepi64_si128( r, k3k4, 0x00 );
+        __m128i hi = _mm_clmulepi64_si128( r, k3k4, 0x11 );
+        r = _mm_xor_si128( _mm_xor_si128( lo, hi ), _mm_loadu_si128( (const __m128i*)data ) );
+    }
+
+    // 128 bits into 64
+    __m128i t = _mm_clmulepi64_si128( r, k3k4, 0x10 );
+    r = _mm_xor_si128( _mm_srli_si128( r, 8 ), t );
+    t = _mm_srli_si128( r, 4 );
+    r = _mm_clmulepi64_si128( _mm_and_si128( r, mask32 ), k5k0, 0x00 );
+    r = _mm_xor_si128( r, t );
+
+    // Barrett reduction
+    t = _mm_clmulepi64_si128( _mm_and_si128( r, mask32 ), poly, 0x10 );
+    t = _mm_clmulepi64_si128( _mm_and_si128( t, mask32 ), poly, 0x00 );
+    r = _mm_xor_si128( r, t );
+    c = _mm_extract_epi32( r, 1 );
+
+    // bytes left
+    return ~crcBytes( data, size, c );
+}
+
+#endif
+
+namespace
+{
+
+inline uint32_t rol( uint32_t v, int n )
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+}
+
+void sha1BlocksScalar( uint32_t* state, const uint8_t* blocks, size_t n )
+{
+    for ( ; n > 0; n--, blocks += 64 ) {
+        uint32_t w[80];
+        for ( int i = 0; i < 16; i++ ) {
+            const uint8_t* p = blocks + i * 4;
+            w[i] = (uint32_t( p[0] ) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        }
+        for ( int i = 16; i < 80; i++ ) {
+            w[i] = rol( w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1 );
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for ( int i = 0; i < 80; i++ ) {
+            uint32_t f, k;
+            if ( i < 20 ) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if ( i < 40 ) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if ( i < 60 ) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol( a, 5 ) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol( b, 30 );
+            b = a;
+            a = t;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Intel SHA extensions: 4 rounds per instruction, the message schedule
+// of the next groups computed along
+__attribute__((target("sha,ssse3,sse4.1")))
+void sha1BlocksSHA( uint32_t* state, const uint8_t* blocks, size_t n )
+{
+    const __m128i swap = _mm_set_epi64x( 0x0001020304050607LL, 0x08090a0b0c0d0e0fLL );
+    __m128i abcd = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i*)state ), 0x1B );
+    __m128i e0 = _mm_set_epi32( state[4], 0, 0, 0 );
+
+    for ( ; n > 0; n--, blocks += 64 ) {
+        __m128i abcdSaved = abcd;
+        __m128i eSaved = e0;
+        __m128i msg[4];
+        __m128i e[2] = { e0, e0 };
+
+        // group g: rounds 4g to 4g+3, words of msg[g % 4]
+        for ( int g = 0; g < 20; g++ ) {
+            __m128i& cur = e[g & 1];
+            __m128i& m = msg[g & 3];
+            if ( g < 4 ) {
+                m = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i*)(blocks + g * 16) ), swap );
+            }
+            cur = g == 0 ? _mm_add_epi32( cur, m ) : _mm_sha1nexte_epu32( cur, m );
+            e[(g + 1) & 1] = abcd;
+            switch ( g / 5 ) {
+            case 0: abcd = _mm_sha1rnds4_epu32( abcd, cur, 0 ); break;
+            case 1: abcd = _mm_sha1rnds4_epu32( abcd, cur, 1 ); break;
+            case 2: abcd = _mm_sha1rnds4_epu32( abcd, cur, 2 ); break;
+            default: abcd = _mm_sha1rnds4_epu32( abcd, cur, 3 ); break;
+            }
+            // words of the groups g+1 to g+3
+            if ( g >= 3 && g <= 18 ) {
+                msg[(g + 1) & 3] = _mm_sha1msg2_epu32( msg[(g + 1) & 3], m );
+            }
+            if ( g >= 2 && g <= 17 ) {
+                msg[(g + 2) & 3] = _mm_xor_si128( msg[(g + 2) & 3], m );
+            }
+            if ( g >= 1 && g <= 16 ) {
+                msg[(g + 3) & 3] = _mm_sha1msg1_epu32( msg[(g + 3) & 3], m );
+            }
+        }
+
+        e0 = _mm_sha1nexte_epu32( e[0], eSaved );
+        abcd = _mm_add_epi32( abcd, abcdSaved );
+    }
+
+    _mm_storeu_si128( (__m128i*)state, _mm_shuffle_epi32( abcd, 0x1B ) );
+    state[4] = _mm_extract_epi32( e0, 3 );
+}
+
+#endif
+
+void sha1With( Sha1Blocks blocks, const uint8_t* data, size_t size, uint8_t* digest )
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t full = size / 64;
+    blocks( state, data, full );
+
+    // padding: 0x80, zeros, then the size in bits, big endian
+    uint8_t tail[128];
+    size_t left = size - full * 64;
+    memcpy( tail, data + full * 64, left );
+    size_t tailSize = left < 56 ? 64 : 128;
+    memset( tail + left, 0, tailSize - left );
+    tail[left] = 0x80;
+    uint64_t bits = uint64_t( size ) * 8;
+    for ( int i = 0; i < 8; i++ ) {
+        tail[tailSize - 1 - i] = uint8_t( bits >> (i * 8) );
+    }
+    blocks( state, tail, tailSize / 64 );
+
+    for ( int i = 0; i < 5; i++ ) {
+        digest[i * 4 + 0] = uint8_t( state[i] >> 24 );
+        digest[i * 4 + 1] = uint8_t( state[i] >> 16 );
+        digest[i * 4 + 2] = uint8_t( state[i] >> 8 );
+        digest[i * 4 + 3] = uint8_t( state[i] );
+    }
+}
+
+namespace
+{
+
+struct Selected
+{
+    uint32_t (*crc)( const uint8_t*, size_t, uint32_t );
+    Sha1Blocks sha;
+    const char* name;
+    Selected()
+    {
+        crc = crc32SliceBy8;
+        sha = sha1BlocksScalar;
+        name = "slice-by-8, scalar sha1";
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        bool clmul = __builtin_cpu_supports( "pclmul" ) && __builtin_cpu_supports( "sse4.1" );
+        bool sha = hasShaExtensions() && __builtin_cpu_supports( "sse4.1" );
+        if ( clmul ) {
+            crc = crc32Clmul;
+        }
+        if ( sha ) {
+            this->sha = sha1BlocksSHA;
+        }
+        name = clmul ? (sha ? "pclmul, sha-ni" : "pclmul, scalar sha1") :
+                       (sha ? "slice-by-8, sha-ni" : "slice-by-8, scalar sha1");
+#endif
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // not known to __builtin_cpu_supports by all compilers: CPUID leaf 7, EBX bit 29
+    static bool hasShaExtensions()
+    {
+        uint32_t a, b, c, d;
+        __asm__( "cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0) );
+        if ( a < 7 ) {
+            return false;
+        }
+        __asm__( "cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0) );
+        return (b >> 29) & 1;
+    }
+#endif
+};
+
+}
+
+static const Selected selected;
+
+uint32_t crc32( const uint8_t* data, size_t size, uint32_t crc )
+{
+    return selected.crc( data, size, crc );
+}
+
+void sha1( const uint8_t* data, size_t size, uint8_t* digest )
+{
+    sha1With( selected.sha, data, size, digest );
+}
+
+const char* checksumNames()
+{
+    return selected.name;
+}
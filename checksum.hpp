@@ -0,0 +1,36 @@
+#ifndef NES_CHECKSUM_HPP
+#define NES_CHECKSUM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+///
+/// Checksums identifying ROM images, as listed by the ROM databases
+///
+/// Both use the carry-less multiply (PCLMULQDQ) and SHA instructions when
+/// the processor has them.
+
+/// CRC-32 (IEEE 802.3, the one of zip and zlib) of size bytes
+/// crc: CRC of the previous bytes, to continue it
+uint32_t crc32( const uint8_t* data, size_t size, uint32_t crc = 0 );
+
+/// SHA-1 of size bytes, digest receives 20 bytes
+void sha1( const uint8_t* data, size_t size, uint8_t* digest );
+
+/// Implementations, for tests and benchmarks
+uint32_t crc32SliceBy8( const uint8_t* data, size_t size, uint32_t crc );
+#if defined(__x86_64__) || defined(__i386__)
+uint32_t crc32Clmul( const uint8_t* data, size_t size, uint32_t crc );
+#endif
+// hash blocks of 64 bytes into state
+typedef void (*Sha1Blocks)( uint32_t* state, const uint8_t* blocks, size_t n );
+void sha1BlocksScalar( uint32_t* state, const uint8_t* blocks, size_t n );
+#if defined(__x86_64__) || defined(__i386__)
+void sha1BlocksSHA( uint32_t* state, const uint8_t* blocks, size_t n );
+#endif
+void sha1With( Sha1Blocks blocks, const uint8_t* data, size_t size, uint8_t* digest );
+
+/// names of the implementations used by crc32 and sha1
+const char* checksumNames();
+
+#endif
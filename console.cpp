@@ -0,0 +1,251 @@
+#include <stdexcept>
+
+#include "console.hpp"
+#include "trace.hpp"
+
+Console::Console( Frontend* frontend ) : ram_( 2048 ),
+                                         file_( 0 ),
+                                         mapper_( 0 ),
+                                         ppu_( &cpu_, frontend ),
+                                         apu_( &cpu_, &controller_, frontend ),
+                                         blocks_( &cpu_ ),
+                                         interpreter_( false ),
+                                         useBlocks_( true ),
+                                         debug_( false ),
+                                         instructions_( 0 )
+{
+    InstructionDefinition::initTable();
+
+    cpu_.pc = 0;
+    cpu_.sp = 0xFD;
+    cpu_.status = 0x24;
+    cpu_.regA = 0;
+    cpu_.regX = 0;
+    cpu_.regY = 0;
+    cpu_.cycles = 0;
+}
+
+Console::~Console()
+{
+    delete mapper_;
+    delete file_;
+}
+
+void Console::load( const std::string& nesFilePath )
+{
+    // the ROMs are used in place in the mapped file
+    NesFile* file = new NesFile( nesFilePath );
+    Mapper* mapper;
+    try {
+        mapper = Mapper::create( *file, &cpu_, &ppu_ );
+    }
+    catch ( ... ) {
+        delete file;
+        throw;
+    }
+    header_ = file->header();
+    // the previous cartridge stays on the bus until replaced
+    NesFile* previousFile = file_;
+    Mapper* previous = mapper_;
+    file_ = file;
+    mapper_ = mapper;
+
+    cpu_.addOnBus( 0x0000, &ram_, 0x0000 );
+    cpu_.addOnBus( 0x0800, &ram_, 0x0800 );
+    cpu_.addOnBus( 0x1000, &ram_, 0x1000 );
+    cpu_.addOnBus( 0x1800, &ram_, 0x1800 );
+    for ( int i = 0; i < 0x2000 / 8; i += 8 ) {
+        cpu_.addOnBus( 0x2000+i, &ppu_, 0x2000+i );
+    }
+    cpu_.addOnBus( 0x4000, &apu_, 0x4000 );
+    cpu_.addOnBus( 0x4020, mapper_, 0 );
+    cpu_.addOnBus( 0x6000, &mapper_->prgRam(), 0x6000 );
+    cpu_.addOnBus( 0x8000, mapper_, 0 );
+    delete previous;
+    delete previousFile;
+
+    mapper_->apply();
+    ppu_.setMapper( mapper_ );
+    cpu_.reset();
+    blocks_.invalidate();
+}
+
+void Console::setInterpreter( bool interpreter )
+{
+    interpreter_ = interpreter;
+    if ( interpreter ) {
+        useBlocks_ = false;
+    }
+}
+
+template <class Policy>
+void Console::stepWith()
+{
+    cpu_.cycles = 0;
+    if ( cpu_.irqPending() ) {
+        cpu_.triggerIRQ();
+    }
+    else {
+        // run a whole block of instructions when nothing needs
+        // per-instruction accuracy until the next PPU event
+        if ( Policy::Watches && cpu_.watchpoints().test( Watchpoints::Execute, cpu_.pc ) ) {
+            cpu_.watchpoints().hit( Watchpoints::Execute, cpu_.pc );
+            cpu_.raise( Fault::ExecuteWatch, cpu_.pc );
+            return;
+        }
+        const Superblock* block = 0;
+        if ( useBlocks_ && !(Policy::Watches && cpu_.hasWatches()) ) {
+            block = blocks_.find( cpu_.pc );
+        }
+        if ( block && (cpu_.cycleCount + block->maxCycles) * 3 < ppu_.nextEvent() &&
+             cpu_.cycleCount + block->maxCycles < apu_.nextEvent() ) {
+            if ( Policy::Profile && cpu_.profiler() ) {
+                blocks_.runProfiled( *block, *cpu_.profiler() );
+            }
+            else {
+                blocks_.run( *block );
+            }
+            instructions_ += block->ops.size();
+        }
+        else {
+            uint16_t pc = cpu_.pc;
+            Instruction instr = cpu_.decode( pc );
+            cpu_.pc += instr.nOperands + 1;
+            instructions_++;
+            if ( interpreter_ ) {
+                cpu_.execute<Policy>( instr );
+            }
+            else {
+                cpu_.dispatch<Policy>( instr );
+            }
+            // blocks hold no faulting instruction (see isSafe), only this path
+            if ( cpu_.stopped() ) {
+                cpu_.locateFault( pc );
+            }
+            if ( Policy::Profile && cpu_.profiler() ) {
+                cpu_.profiler()->count( pc, instr.opcode, cpu_.cycles, cpu_.pc, cpu_.sp );
+            }
+        }
+    }
+    cpu_.cycleCount += cpu_.cycles;
+    // the PPU catches up by itself when its registers are accessed,
+    // wake it up for the next frame, vblank or scanline count
+    if ( cpu_.cycleCount * 3 >= ppu_.nextEvent() ) {
+        ppu_.sync( ppu_.nextEvent() );
+    }
+    // and the APU for its interrupts
+    if ( cpu_.cycleCount >= apu_.nextEvent() ) {
+        apu_.sync();
+    }
+}
+
+void Console::step()
+{
+    if ( debug_ ) {
+        stepWith<DebugPolicy>();
+    }
+    else if ( cpu_.profiler() ) {
+        stepWith<ProfilePolicy>();
+    }
+    else {
+        stepWith<ReleasePolicy>();
+    }
+}
+
+void Console::runFrame()
+{
+    uint64_t frame = ppu_.frameCount();
+    if ( debug_ ) {
+        NES_TRACE_SCOPE( CpuDebug );
+        while ( ppu_.frameCount() == frame && !cpu_.stopped() ) {
+            stepWith<DebugPolicy>();
+        }
+    }
+    else if ( cpu_.profiler() ) {
+        NES_TRACE_SCOPE( Cpu );
+        while ( ppu_.frameCount() == frame && !cpu_.stopped() ) {
+            stepWith<ProfilePolicy>();
+        }
+    }
+    else {
+        NES_TRACE_SCOPE( Cpu );
+        while ( ppu_.frameCount() == frame && !cpu_.stopped() ) {
+            stepWith<ReleasePolicy>();
+        }
+    }
+    if ( cpu_.profiler() && ppu_.frameCount() != frame ) {
+        cpu_.profiler()->endFrame();
+    }
+    NES_TRACE_SCOPE( Apu );
+    apu_.flush();
+}
+
+void Console::runFrameAhead( int frames )
+{
+    if ( frames <= 0 ) {
+        runFrame();
+        return;
+    }
+    // a fault stops the run where it happened, frames ahead included
+    ppu_.setVideo( false );
+    runFrame();
+    if ( !cpu_.stopped() ) {
+        save( aheadState_ );
+        // the frames ahead are thrown away, their instructions too
+        uint64_t instructions = instructions_;
+        // the sound of the frames ahead would be played twice
+        apu_.setAudio( false );
+        for ( int i = 0; i < frames && !cpu_.stopped(); i++ ) {
+            ppu_.setVideo( i == frames - 1 );
+            runFrame();
+        }
+        if ( !cpu_.stopped() ) {
+            // back on the real timeline, where the sound stopped
+            loadState( aheadState_ );
+            instructions_ = instructions;
+        }
+    }
+    ppu_.setVideo( true );
+    apu_.setAudio( true );
+}
+
+void Console::save( SaveState& state ) const
+{
+    state.magic = SaveState::Magic;
+    state.version = SaveState::Version;
+    state.size = sizeof( SaveState );
+    cpu_.saveState( state.cpu );
+    memcpy( state.ram, ram_.data(), sizeof(state.ram) );
+    ppu_.saveState( state.ppu );
+    apu_.saveState( state.apu );
+    if ( mapper_ ) {
+        mapper_->saveState( state.mapper );
+    }
+    controller_.saveState( state.controller );
+}
+
+void Console::restore( const SaveState& state )
+{
+    if ( state.magic != SaveState::Magic ||
+         state.version != SaveState::Version ||
+         state.size != sizeof( SaveState ) ) {
+        throw std::runtime_error( "incompatible save state" );
+    }
+    loadState( state );
+    // the samples of the abandoned timeline are dropped
+    apu_.dropAudio();
+}
+
+void Console::loadState( const SaveState& state )
+{
+    memcpy( ram_.data(), state.ram, sizeof(state.ram) );
+    ppu_.loadState( state.ppu );
+    apu_.loadState( state.apu );
+    // the banks, once the PPU is restored
+    if ( mapper_ ) {
+        mapper_->loadState( state.mapper );
+    }
+    controller_.loadState( state.controller );
+    // last, once the memory is restored
+    cpu_.loadState( state.cpu );
+}
@@ -0,0 +1,119 @@
+#ifndef NES_CONSOLE_HPP
+#define NES_CONSOLE_HPP
+
+#include <string>
+
+#include "nes_file_importer.hpp"
+#include "cpu.hpp"
+#include "superblock.hpp"
+#include "ppu.hpp"
+#include "apu.hpp"
+#include "controller.hpp"
+#include "mapper.hpp"
+#include "savestate.hpp"
+
+class Frontend;
+
+///
+/// The NES: devices wired on the CPU bus, loaded with a cartridge
+///
+/// The console does not depend on any host library, the video and input
+/// go through the frontend given at construction.
+class Console
+{
+public:
+    Console( Frontend* frontend );
+    ~Console();
+
+    /// Load an iNES file and reset the CPU
+    /// Throws std::runtime_error if the file cannot be read or if its
+    /// mapper is not supported
+    void load( const std::string& nesFilePath );
+
+    const iNESHeader& header() const { return header_; }
+
+    /// Use the switch based interpreter instead of the threaded dispatch
+    /// (also disables blocks)
+    void setInterpreter( bool interpreter );
+    /// Run basic blocks of ROM code in one call (threaded dispatch only)
+    void setBlocks( bool useBlocks ) { useBlocks_ = useBlocks && !interpreter_; }
+    bool interpreter() const { return interpreter_; }
+    bool blocks() const { return useBlocks_; }
+
+    /// Debugger hooks of the CPU: with debug on, the watches are checked on
+    /// each memory access (DebugPolicy), otherwise they are compiled out of
+    /// the instructions (ReleasePolicy), the default
+    /// The host switches between frames: runFrame() chooses the policy
+    /// once for the whole frame.
+    void setDebug( bool debug ) { debug_ = debug; }
+    bool debug() const { return debug_; }
+
+    /// Count the instructions run in profiler (not owned), 0 to stop
+    /// Without debug, the frames run with ProfilePolicy, the release
+    /// core plus the counting.
+    void setProfiler( Profiler* profiler ) { cpu_.setProfiler( profiler ); }
+    Profiler* profiler() const { return cpu_.profiler(); }
+
+    /// Run one block of instructions, or one instruction, or enter the IRQ
+    /// handler, then wake the PPU up if one of its events is due
+    /// In debug, the watches raise CPU faults, an execute watch before the
+    /// instruction is run.
+    void step();
+
+    /// Instructions run since construction, not counting the frames run
+    /// ahead and thrown away
+    uint64_t instructions() const { return instructions_; }
+
+    /// Run until the next frame is presented, and flush its audio
+    /// Stops early on a CPU fault, see CPU::stopped()
+    void runFrame();
+
+    /// Run-ahead, to hide the latency of the games that react to input
+    /// a few frames later
+    /// Runs the next frame without presenting it, then frames more with
+    /// the current input, presents the last one and comes back to the end
+    /// of the first frame. Extra frames are not drawn. A CPU fault stops it
+    /// where it happened.
+    void runFrameAhead( int frames );
+
+    /// Snapshot of the whole console, between two steps
+    void save( SaveState& state ) const;
+    /// Restore a snapshot of the same ROM
+    /// Throws std::runtime_error if it comes from another version
+    void restore( const SaveState& state );
+
+    CPU& cpu() { return cpu_; }
+    PPU& ppu() { return ppu_; }
+    APU& apu() { return apu_; }
+    Controller& controller() { return controller_; }
+    Mapper* mapper() { return mapper_; }
+    SuperblockEngine& superblocks() { return blocks_; }
+
+private:
+    template <class Policy>
+    void stepWith();
+    // restore without checks, the audio pending is kept (run-ahead)
+    void loadState( const SaveState& state );
+
+    iNESHeader header_;
+
+    CPU cpu_;
+    RAM ram_;
+    // cartridge, once loaded
+    NesFile* file_;
+    Mapper* mapper_;
+    Controller controller_;
+    PPU ppu_;
+    APU apu_;
+    SuperblockEngine blocks_;
+
+    bool interpreter_;
+    bool useBlocks_;
+    bool debug_;
+    uint64_t instructions_;
+
+    // state to come back to after a run-ahead
+    SaveState aheadState_;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef NES_CONTROLLER_HPP
 #define NES_CONTROLLER_HPP
 
+#include <stdint.h>
 #include <iostream>
 
 ///
@@ -26,9 +27,37 @@ class Controller
         }
         idx_[0] = -1;
         idx_[1] = -1;
+        strobe_ = false;
     }
     ~Controller() {}
 
+    /// Saved state
+    struct State
+    {
+        uint8_t pressed[2][8];
+        uint8_t strobe;
+        int8_t idx[2];
+    };
+    void saveState( State& state ) const
+    {
+        for ( int i = 0; i < 2; i++ ) {
+            for ( int j = 0; j < 8; j++ ) {
+                state.pressed[i][j] = pressed_[i][j];
+            }
+            state.idx[i] = idx_[i];
+        }
+        state.strobe = strobe_;
+    }
+    /// Only the shift registers are restored: the buttons are those held
+    /// on the host now, not when the state was saved
+    void loadState( const State& state )
+    {
+        for ( int i = 0; i < 2; i++ ) {
+            idx_[i] = state.idx[i];
+        }
+        strobe_ = state.strobe;
+    }
+
     void setState( int controller, int button, bool pressed )
     {
         pressed_[ controller ][ button ] = pressed;
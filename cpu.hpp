@@ -1,11 +1,15 @@
+#ifndef NES_CPU_HPP
+#define NES_CPU_HPP
+
 #include <stdint.h>
 #include <string.h>
 #include <istream>
 #include <string>
-#include <set>
 #include <map>
+#include <vector>
 
 #include "bus_device.hpp"
+#include "watchpoints.hpp"
 
 struct InstructionDefinition
 {
@@ -122,8 +126,40 @@ struct InstructionDefinition
         return table_;
     }
 
+    // fill the table, once for the whole process (thread safe)
     static void initTable();
 
+    // stores and read-modify-writes: the operand is an address written to
+    // (the shifts and rotations also have an accumulator form)
+    static bool writesMemory( Mnemonic mnemonic )
+    {
+        switch ( mnemonic )
+        {
+        case MNEMONIC_STA:
+        case MNEMONIC_STX:
+        case MNEMONIC_STY:
+        case MNEMONIC_SAX:
+        case MNEMONIC_INC:
+        case MNEMONIC_DEC:
+        case MNEMONIC_ASL:
+        case MNEMONIC_LSR:
+        case MNEMONIC_ROL:
+        case MNEMONIC_ROR:
+        case MNEMONIC_DCP:
+        case MNEMONIC_ISC:
+        case MNEMONIC_SLO:
+        case MNEMONIC_RLA:
+        case MNEMONIC_SRE:
+        case MNEMONIC_RRA:
+            return true;
+        default:
+            return false;
+        }
+    }
+private:
+    static bool buildTable();
+public:
+
     // default constructor
     InstructionDefinition() : valid( false ) {}
 
@@ -142,6 +178,16 @@ struct InstructionDefinition
     }
 };
 
+// names of the addressing modes
+extern const char * AddressingString[];
+
+struct CPU;
+struct Instruction;
+class Profiler;
+
+// specialized instruction handler, see CPU::dispatch
+typedef void (*InstructionHandler)( CPU&, const Instruction& );
+
 struct Instruction
 {
     // raw opcode
@@ -150,10 +196,16 @@ struct Instruction
     int nOperands;
     // operands, if needed
     uint8_t operand1, operand2;
-    // valid ?
+    // addressing mode
+    InstructionDefinition::Addressing addressing;
+    // definition in the global table
+    const InstructionDefinition* def;
+    // specialized handler
+    InstructionHandler handler;
+    // decoded ?
     bool valid;
 
-    Instruction() : valid( false ) {}
+    Instruction() : def( 0 ), handler( 0 ), valid( false ) {}
 };
 std::ostream& operator<<( std::ostream& ostr, const Instruction& instr );
 
@@ -174,51 +226,77 @@ public:
     {
         memset( &mem_[0], init, size_ );
     }
+    // out of the memory: open bus, the write is lost
     virtual uint8_t read( uint16_t addr ) const
     {
-        if ( addr >= size_ ) {
-            throw OutOfBoundAddress();
-        }
-        return mem_[addr];
+        return addr < size_ ? mem_[addr] : 0xFF;
     }
     virtual void write( uint16_t addr, uint8_t val )
+    {
+        if ( addr < size_ ) {
+            mem_[addr] = val;
+        }
+    }
+    virtual uint8_t* storage( uint16_t addr, size_t& size )
     {
         if ( addr >= size_ ) {
-            throw OutOfBoundAddress();
+            return 0;
         }
-        mem_[addr] = val;
+        size = size_ - addr;
+        return &mem_[addr];
     }
+    virtual bool writableStorage() const { return true; }
+
+    size_t size() const { return size_; }
+    uint8_t* data() { return &mem_[0]; }
+    const uint8_t* data() const { return &mem_[0]; }
 private:
     std::vector<uint8_t> mem_;
     size_t size_;
 };
 
+/// Read-only memory used in place, src must outlive the device
 class ROM : public BusDevice
 {
 public:
-    ROM( size_t size, uint8_t* src ) : size_(size), mem_(size)
+    ROM( size_t size, uint8_t* src ) : size_(size), mem_(src)
     {
-        memcpy( &mem_[0], src, size_ );
     }
     virtual uint8_t read( uint16_t addr ) const
     {
-        if ( addr >= size_ ) {
-            throw OutOfBoundAddress();
-        }
-        return mem_[addr];
+        return addr < size_ ? mem_[addr] : 0xFF;
     }
-    virtual void write( uint16_t addr, uint8_t val )
+    virtual void write( uint16_t, uint8_t )
+    {
+        // nothing
+    }
+    virtual uint8_t* storage( uint16_t addr, size_t& size )
     {
         if ( addr >= size_ ) {
-            throw OutOfBoundAddress();
+            return 0;
         }
-        // nothing
+        size = size_ - addr;
+        return &mem_[addr];
     }
 private:
-    std::vector<uint8_t> mem_;
     size_t size_;
+    uint8_t* mem_;
 };
 
+///
+/// CPU address space
+///
+/// Devices are registered by start address: a device covers the bus from
+/// its start address up to the start of the next registered device.
+///
+/// Lookups go through a flat table of 256 pages of 256 bytes, rebuilt on
+/// each insertion. Pages entirely backed by a plain memory (RAM, ROM) are
+/// read (and written, for RAM) through a pointer. Other pages dispatch to
+/// the device, with a per-address slot table when several devices share
+/// the same page (the PPU registers for instance).
+///
+/// Bank switching only refreshes the pointers of the pages involved, the
+/// memory behind them is never copied.
 class MemoryMap
 {
 public:
@@ -227,33 +305,241 @@ public:
     void insert( uint16_t startAddress, BusDevice* dev, uint16_t offset )
     {
         map_[startAddress] = std::make_pair( dev, offset );
+        rebuild();
+    }
+
+    /// Ask the devices again for the storage of the pages of [addr, addr+size)
+    /// (after a bank switch)
+    void refresh( uint16_t addr, size_t size )
+    {
+        bool relink = false;
+        for ( size_t p = addr >> 8; p < 256 && p < ((addr + size + 0xFF) >> 8); p++ ) {
+            relink = relink || pages_[p].write;
+            if ( !pages_[p].slots ) {
+                mapStorage( pages_[p], p << 8 );
+            }
+            relink = relink || pages_[p].write;
+        }
+        // only writable pages are linked to their mirrors
+        if ( relink ) {
+            linkMirrors();
+        }
     }
 
     uint8_t read( uint16_t addr ) const
     {
-        MMap::const_iterator it = map_.upper_bound( addr );
-        if ( it != map_.begin() ) --it;
-        BusDevice * dev = it->second.first;
-        uint16_t offset = it->second.second;
-        return dev->read( addr - offset );
+        const Page& page = pages_[addr >> 8];
+        if ( page.read ) {
+            return page.read[addr & 0xFF];
+        }
+        const Slot& slot = page.slots ? page.slots[addr & 0xFF] : page.slot;
+        return slot.dev->read( addr - slot.offset );
     }
 
     void write( uint16_t addr, uint8_t val )
     {
+        const Page& page = pages_[addr >> 8];
+        if ( page.write ) {
+            page.write[addr & 0xFF] = val;
+            return;
+        }
+        const Slot& slot = page.slots ? page.slots[addr & 0xFF] : page.slot;
+        return slot.dev->write( addr - slot.offset, val );
+    }
+
+    // true if the page of addr is read straight from memory
+    bool isDirectRead( uint16_t addr ) const
+    {
+        return pages_[addr >> 8].read != 0;
+    }
+    // true if the page of addr is written straight to memory
+    bool isDirectWrite( uint16_t addr ) const
+    {
+        return pages_[addr >> 8].write != 0;
+    }
+    // memory the page of addr is read from, or 0
+    const uint8_t* pageMemory( uint16_t addr ) const
+    {
+        return pages_[addr >> 8].read;
+    }
+    // next page mapped on the same writable memory as page (mirrors)
+    // page itself if it is not mirrored
+    uint8_t nextMirror( uint8_t page ) const
+    {
+        return pages_[page].mirror;
+    }
+
+private:
+    // device and address offset
+    struct Slot
+    {
+        BusDevice* dev;
+        uint16_t offset;
+        Slot() : dev( 0 ), offset( 0 ) {}
+    };
+
+    struct Page
+    {
+        // direct pointers to the 256 bytes of the page, or 0
+        const uint8_t* read;
+        uint8_t* write;
+        // device of the page, when only one device covers it
+        Slot slot;
+        // per address devices, when the page is shared, or 0
+        const Slot* slots;
+        // next page backed by the same memory
+        uint8_t mirror;
+    };
+
+    // device covering addr, as resolved by the registration map
+    Slot lookup( uint16_t addr ) const
+    {
+        Slot s;
         MMap::const_iterator it = map_.upper_bound( addr );
         if ( it != map_.begin() ) --it;
-        BusDevice * dev = it->second.first;
-        uint16_t offset = it->second.second;
-        return dev->write( addr - offset, val );
+        s.dev = it->second.first;
+        s.offset = it->second.second;
+        return s;
+    }
+
+    void rebuild()
+    {
+        // count shared pages first, slot pointers must stay valid
+        std::vector<bool> shared( 256, false );
+        size_t nShared = 0;
+        for ( MMap::const_iterator it = map_.begin(); it != map_.end(); ++it ) {
+            if ( (it->first & 0xFF) && !shared[it->first >> 8] ) {
+                shared[it->first >> 8] = true;
+                nShared++;
+            }
+        }
+        sharedSlots_.assign( nShared * 256, Slot() );
+
+        size_t n = 0;
+        for ( int p = 0; p < 256; p++ ) {
+            Page& page = pages_[p];
+            uint16_t base = p << 8;
+            page.read = 0;
+            page.write = 0;
+            page.slots = 0;
+            page.slot = lookup( base );
+
+            if ( shared[p] ) {
+                Slot* slots = &sharedSlots_[n * 256];
+                for ( int i = 0; i < 256; i++ ) {
+                    slots[i] = lookup( base | i );
+                }
+                page.slots = slots;
+                n++;
+                continue;
+            }
+
+            mapStorage( page, base );
+        }
+        linkMirrors();
+    }
+
+    // direct pointers of a page covered by a single device
+    void mapStorage( Page& page, uint16_t base )
+    {
+        size_t size = 0;
+        uint8_t* mem = page.slot.dev->storage( base - page.slot.offset, size );
+        page.read = 0;
+        page.write = 0;
+        if ( mem && size >= 256 ) {
+            page.read = mem;
+            if ( page.slot.dev->writableStorage() ) {
+                page.write = mem;
+            }
+        }
+    }
+
+    // link mirrors of the same writable memory in a ring
+    // (only writes need to reach the mirrors, see CPU::invalidateDecoded)
+    void linkMirrors()
+    {
+        for ( int p = 0; p < 256; p++ ) {
+            pages_[p].mirror = p;
+            if ( !pages_[p].write ) {
+                continue;
+            }
+            for ( int q = (p + 1) & 0xFF; q != p; q = (q + 1) & 0xFF ) {
+                if ( pages_[q].write == pages_[p].write ) {
+                    pages_[p].mirror = q;
+                    break;
+                }
+            }
+        }
     }
 
-private:
     typedef std::map<uint16_t, std::pair<BusDevice*, uint16_t > > MMap;
     MMap map_;
+
+    Page pages_[256];
+    std::vector<Slot> sharedSlots_;
+};
+
+///
+/// Debugger hooks of the CPU core, chosen at compile time
+///
+/// The interpreter, the instruction handlers and the memory accesses are
+/// templates on a policy. ReleasePolicy compiles the hooks away,
+/// DebugPolicy checks the breakpoints and watches, ProfilePolicy only
+/// counts the instructions in the profiler (see Console::setProfiler).
+struct ReleasePolicy
+{
+    static const bool Watches = false;
+    static const bool Profile = false;
+};
+
+struct DebugPolicy
+{
+    static const bool Watches = true;
+    static const bool Profile = true;
+};
+
+struct ProfilePolicy
+{
+    static const bool Watches = false;
+    static const bool Profile = true;
 };
 
+///
+/// Why the CPU stopped: a watch, or a fault of the guest
+///
+/// Nothing is thrown while running. The CPU and the devices raise a fault
+/// into the status of the CPU, the run loops check it once per block or
+/// instruction and return to the host, which reports it and clears it.
+struct Fault
+{
+    enum Kind
+    {
+        None,
+        ReadWatch,
+        WriteWatch,
+        // before the instruction at pc
+        ExecuteWatch,
+        // the CPU stays on the instruction
+        IllegalInstruction,
+        NotImplemented,
+        // access to an address that no device register answers
+        BadAddress
+    };
+    Kind kind;
+    // instruction that raised it
+    uint16_t pc;
+    // address accessed, or opcode for the instruction faults
+    uint16_t addr;
+
+    Fault() : kind( None ), pc( 0 ), addr( 0 ) {}
+    static const char* kindName( Kind kind );
+};
+std::ostream& operator<<( std::ostream& ostr, const Fault& fault );
+
 struct CPU
 {
+    CPU() : cycleCount( 0 ), irqLines( 0 ), profiler_( 0 ), writableDecodedPages_( 0 ) {}
+
     uint8_t regA, regX, regY;
     uint8_t status;
 
@@ -266,14 +552,63 @@ struct CPU
     // cycles
     int cycles;
 
-    uint8_t *memory;
+    // cycles elapsed before the current instruction
+    // master clock of the other devices (see PPU::sync)
+    uint64_t cycleCount;
 
+    // interrupt request lines held by the devices, one bit per source
+    uint8_t irqLines;
+
+    template <class Policy>
     void execute( const Instruction& instr );
+
+    /// Threaded dispatch: execute instr through the handler specialized
+    /// for its opcode, addressing mode and operation fused at compile time.
+    /// Same behaviour as execute(), for one indirect call.
+    /// The decoded instructions hold the release handler.
+    template <class Policy>
+    void dispatch( const Instruction& instr )
+    {
+        if ( Policy::Watches ) {
+            handlers<Policy>()[instr.opcode]( *this, instr );
+        }
+        else {
+            instr.handler( *this, instr );
+        }
+    }
+    /// handlers of the threaded dispatch, indexed by opcode
+    template <class Policy>
+    static const InstructionHandler* handlers();
+
+    template <class Policy>
     uint8_t resolveAddressing( const Instruction& instr );
+    template <class Policy>
     uint16_t resolveWAddressing( const Instruction& instr );
 
-    uint8_t readMem8( uint16_t addr, bool quiet = false ) const;
-    void writeMem8( uint16_t addr, uint8_t v, bool quiet = false );
+    /// Memory accesses
+    /// The accesses made outside of the instructions (vectors, DMA, code
+    /// fetch) keep the watches.
+    template <class Policy = DebugPolicy>
+    uint8_t readMem8( uint16_t addr, bool quiet = false ) const
+    {
+        if ( Policy::Watches && watchpoints_.test( Watchpoints::Read, addr ) ) {
+            watchpoints_.hit( Watchpoints::Read, addr );
+            raise( Fault::ReadWatch, addr );
+        }
+        return busDevice.read( addr );
+    }
+    template <class Policy = DebugPolicy>
+    void writeMem8( uint16_t addr, uint8_t v, bool quiet = false )
+    {
+        busDevice.write( addr, v );
+        if ( writableDecodedPages_ && busDevice.isDirectWrite( addr ) ) {
+            invalidateDecoded( addr );
+        }
+        if ( Policy::Watches && watchpoints_.test( Watchpoints::Write, addr ) ) {
+            watchpoints_.hit( Watchpoints::Write, addr );
+            raise( Fault::WriteWatch, addr );
+        }
+    }
 
     // update status based on a stored value
     void updateStatus( uint8_t v );
@@ -282,26 +617,75 @@ struct CPU
     void updateNStatus( uint8_t v );
     void updateZStatus( uint8_t v );
 
-    void push( uint16_t v );
-    void pushByte( uint8_t v );
-    uint16_t pop();
-    uint8_t popByte();
+    template <class Policy = DebugPolicy>
+    void push( uint16_t v )
+    {
+        pushByte<Policy>( v >> 8 );
+        pushByte<Policy>( v & 0xff );
+    }
+    template <class Policy = DebugPolicy>
+    void pushByte( uint8_t v )
+    {
+        writeMem8<Policy>( 0x100 + sp, v );
+        sp--;
+    }
+    template <class Policy = DebugPolicy>
+    uint16_t pop()
+    {
+        uint16_t v = popByte<Policy>();
+        v |= popByte<Policy>() << 8;
+        return v;
+    }
+    template <class Policy = DebugPolicy>
+    uint8_t popByte()
+    {
+        sp++;
+        return readMem8<Policy>( 0x100 + sp );
+    }
 
     void branchTo( uint16_t );
 
-    void addReadWatch( uint16_t );
-    void addWriteWatch( uint16_t );
+    /// Breakpoints and watches, checked by DebugPolicy
+    Watchpoints& watchpoints() { return watchpoints_; }
+    const Watchpoints& watchpoints() const { return watchpoints_; }
+    bool hasWatches() const { return watchpoints_.active(); }
+
+    /// Stop status, see Fault
+    /// The first fault is kept until cleared, the instructions go on until
+    /// the end of the current block or instruction.
+    bool stopped() const { return fault_.kind != Fault::None; }
+    const Fault& fault() const { return fault_; }
+    void raise( Fault::Kind kind, uint16_t addr ) const
+    {
+        if ( fault_.kind == Fault::None ) {
+            fault_.kind = kind;
+            fault_.pc = pc;
+            fault_.addr = addr;
+        }
+    }
+    /// The fault was raised by the instruction at pc (pc has moved since)
+    void locateFault( uint16_t pc ) { fault_.pc = pc; }
+    void clearFault() { fault_ = Fault(); }
 
-    struct ReadWatchTriggered {};
-    struct WriteWatchTriggered {};
-    struct NotImplemented {};
+    /// Profiler told about the interrupts, not owned, 0 for none
+    /// The instructions are counted by the run loops, see ProfilePolicy.
+    void setProfiler( Profiler* profiler ) { profiler_ = profiler; }
+    Profiler* profiler() const { return profiler_; }
 
     /// Memory mapping
     /// Connect dev on the memory bus
     /// addr is the address on the bus
     /// offset is where address 0 of the device is mapped
     void addOnBus( uint16_t addr, BusDevice* dev, uint16_t offset );
-
+    const MemoryMap& bus() const { return busDevice; }
+    /// A device switched the banks behind [addr, addr+size)
+    /// The decoded instructions of these pages are checked lazily against
+    /// the new memory.
+    void remapBus( uint16_t addr, size_t size );
+
+    /// Decode the instruction at pc
+    /// Instructions read from plain memory are cached, writes to RAM
+    /// invalidate the matching entries
     Instruction decode( uint16_t pc ) const;
 
     ///
@@ -311,27 +695,81 @@ struct CPU
     /// NMI
     void triggerNMI();
 
+    /// IRQ, level triggered: the line stays asserted until the device
+    /// releases it, and is taken between instructions when I is clear
+    enum IrqSource
+    {
+        IrqMapper = 1,
+        IrqApu = 2
+    };
+    void setIRQ( IrqSource source, bool asserted )
+    {
+        irqLines = asserted ? (irqLines | source) : (irqLines & ~source);
+    }
+    bool irqPending() const { return irqLines && !(status & FLAG_I_MASK); }
+    void triggerIRQ();
+
     // OAM DMA
     void doDMA( uint16_t startAddr );
 
+    /// Saved state (registers and clock)
+    struct State
+    {
+        uint64_t cycleCount;
+        int32_t cycles;
+        uint16_t pc;
+        uint8_t regA, regX, regY;
+        uint8_t status;
+        uint8_t sp;
+        uint8_t irqLines;
+    };
+    void saveState( State& state ) const;
+    /// Restore the registers, the instructions decoded from writable
+    /// memory are forgotten since its content is restored as well
+    void loadState( const State& state );
+
 private:
+    friend struct ThreadedOps;
+
+    template <class Policy>
     uint8_t instr_dec( const Instruction& );
+    template <class Policy>
     uint8_t instr_inc( const Instruction& );
     void instr_cmp( const Instruction&, uint8_t );
     void instr_sbc( const Instruction&, uint8_t );
     void instr_adc( const Instruction&, uint8_t );
+    template <class Policy>
     uint8_t instr_asl( const Instruction&, const InstructionDefinition& );
+    template <class Policy>
     uint8_t instr_rol( const Instruction&, const InstructionDefinition& );
+    template <class Policy>
     uint8_t instr_ror( const Instruction&, const InstructionDefinition& );
+    template <class Policy>
     uint8_t instr_lsr( const Instruction&, const InstructionDefinition& );
     void instr_ora( const Instruction&, uint8_t );
     void instr_and( const Instruction&, uint8_t );
     void instr_eor( const Instruction&, uint8_t );
 
-    std::set<uint16_t> read_watch;
-    std::set<uint16_t> write_watch;
+    Watchpoints watchpoints_;
+    // stop status, raised from the const accesses as well
+    mutable Fault fault_;
+    Profiler* profiler_;
 
     // memory mappings
     // address => ( BusDevice, address offset )
     MemoryMap busDevice;
+
+    // decoded instructions, by page of 256 bytes
+    // allocated on first use, for pages read directly from memory
+    mutable std::vector<Instruction> decoded_[256];
+    // number of allocated pages that are also writable
+    mutable int writableDecodedPages_;
+    // memory each page was decoded from, to notice bank switches
+    mutable const uint8_t* decodedMemory_[256];
+
+    Instruction decodeAt( uint16_t pc ) const;
+    // drop decoded instructions overlapping addr
+    void invalidateDecoded( uint16_t addr );
 };
+
+#endif
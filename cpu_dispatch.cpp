@@ -0,0 +1,424 @@
+#include "cpu.hpp"
+#include "opcodes.hpp"
+
+///
+/// Threaded dispatch
+///
+/// One handler is instantiated per opcode from NES_OPCODES. The mnemonic
+/// and the addressing mode are template parameters, so the switches below
+/// are resolved at compile time and each handler only contains the code of
+/// its own addressing mode and operation.
+///
+/// The debug policy P is a template parameter as well: the release
+/// handlers have no watch checks at all.
+///
+/// The behaviour must stay identical to CPU::execute().
+struct ThreadedOps
+{
+    typedef InstructionDefinition Def;
+
+    static void updateNZ( CPU& cpu, uint8_t v )
+    {
+        cpu.status &= (0xFF - FLAG_N_MASK - FLAG_Z_MASK);
+        cpu.status |= (v & FLAG_N_MASK) | (v ? 0 : FLAG_Z_MASK);
+    }
+
+    static void setCarry( CPU& cpu, bool c )
+    {
+        if ( c ) {
+            cpu.status |= FLAG_C_MASK;
+        }
+        else {
+            cpu.status &= (0xFF - FLAG_C_MASK);
+        }
+    }
+
+    // effective address of an operand
+    // Read: the instruction only reads the operand, a page crossing
+    // costs one more cycle
+    template <class P, int A, bool Read>
+    static uint16_t address( CPU& cpu, const Instruction& instr )
+    {
+        switch ( A )
+        {
+        case Def::ADDRESSING_ZERO_PAGE:
+            return instr.operand1;
+        case Def::ADDRESSING_ZERO_PAGE_X:
+            return uint8_t( instr.operand1 + cpu.regX );
+        case Def::ADDRESSING_ZERO_PAGE_Y:
+            return uint8_t( instr.operand1 + cpu.regY );
+        case Def::ADDRESSING_ABSOLUTE:
+            return instr.operand1 | (instr.operand2 << 8);
+        case Def::ADDRESSING_ABSOLUTE_X:
+        case Def::ADDRESSING_ABSOLUTE_Y: {
+            uint16_t baseAddr = instr.operand1 | (instr.operand2 << 8);
+            uint16_t newAddr = baseAddr + (A == Def::ADDRESSING_ABSOLUTE_X ? cpu.regX : cpu.regY);
+            if ( Read ) {
+                cpu.cycles += ((newAddr & 0xFF00) ^ (baseAddr & 0xFF00)) ? 1 : 0;
+            }
+            return newAddr;
+        }
+        case Def::ADDRESSING_INDIRECT_X: {
+            uint8_t pz = instr.operand1 + cpu.regX;
+            uint16_t addr = cpu.readMem8<P>( pz );
+            pz++; // here is the page 0 wrap
+            addr |= cpu.readMem8<P>( pz ) << 8;
+            return addr;
+        }
+        case Def::ADDRESSING_INDIRECT_Y: {
+            uint8_t pz = instr.operand1;
+            uint16_t addr = cpu.readMem8<P>( pz );
+            pz++; // optional page wrap here
+            addr |= cpu.readMem8<P>( pz ) << 8;
+            uint16_t newAddr = addr + cpu.regY;
+            if ( Read ) {
+                cpu.cycles += ((newAddr & 0xFF00) ^ (addr & 0xFF00)) ? 1 : 0;
+            }
+            return newAddr;
+        }
+        default:
+            cpu.pc -= instr.nOperands + 1;
+            cpu.raise( Fault::NotImplemented, instr.opcode );
+            return 0;
+        }
+    }
+
+    // value of the operand
+    template <class P, int A>
+    static uint8_t operand( CPU& cpu, const Instruction& instr )
+    {
+        switch ( A )
+        {
+        case Def::ADDRESSING_NONE:
+            return 0;
+        case Def::ADDRESSING_IMMEDIATE:
+            return instr.operand1;
+        default:
+            return cpu.readMem8<P>( address<P, A, true>( cpu, instr ) );
+        }
+    }
+
+    // shifts and rotations
+    template <int M>
+    static uint8_t shift( CPU& cpu, uint8_t v )
+    {
+        uint8_t carry = cpu.status & FLAG_C_MASK;
+        switch ( M )
+        {
+        case Def::MNEMONIC_ASL:
+        case Def::MNEMONIC_SLO:
+            setCarry( cpu, v & 0x80 );
+            v = v << 1;
+            break;
+        case Def::MNEMONIC_ROL:
+        case Def::MNEMONIC_RLA:
+            setCarry( cpu, v & 0x80 );
+            v = (v << 1) | carry;
+            break;
+        case Def::MNEMONIC_LSR:
+        case Def::MNEMONIC_SRE:
+            setCarry( cpu, v & 1 );
+            v = v >> 1;
+            break;
+        case Def::MNEMONIC_ROR:
+        case Def::MNEMONIC_RRA:
+            setCarry( cpu, v & 1 );
+            v = (carry << 7) | (v >> 1);
+            break;
+        }
+        updateNZ( cpu, v );
+        return v;
+    }
+
+    // read-modify-write of a shift or rotation, on the accumulator or memory
+    template <class P, int M, int A>
+    static uint8_t modify( CPU& cpu, const Instruction& instr )
+    {
+        if ( A == Def::ADDRESSING_ACCUMULATOR ) {
+            cpu.regA = shift<M>( cpu, cpu.regA );
+            return cpu.regA;
+        }
+        uint16_t addr = address<P, A, false>( cpu, instr );
+        uint8_t v = shift<M>( cpu, cpu.readMem8<P>( addr ) );
+        cpu.writeMem8<P>( addr, v );
+        return v;
+    }
+
+    // increment (D = 1) or decrement (D = -1) memory
+    template <class P, int A, int D>
+    static uint8_t increment( CPU& cpu, const Instruction& instr )
+    {
+        uint16_t addr = address<P, A, false>( cpu, instr );
+        uint8_t v = cpu.readMem8<P>( addr ) + D;
+        cpu.writeMem8<P>( addr, v );
+        updateNZ( cpu, v );
+        return v;
+    }
+
+    static void compare( CPU& cpu, uint8_t reg, uint8_t mem )
+    {
+        setCarry( cpu, reg >= mem );
+        updateNZ( cpu, reg - mem );
+    }
+
+    static void branch( CPU& cpu, const Instruction& instr, bool taken )
+    {
+        if ( !taken ) {
+            return;
+        }
+        uint16_t addr = cpu.pc + (int8_t)instr.operand1;
+        // add +1 cycle on a page crossing
+        cpu.cycles += ((cpu.pc & 0xFF00) ^ (addr & 0xFF00)) ? 2 : 1;
+        cpu.pc = addr;
+    }
+
+    template <class P, int M, int A, int NCycles>
+    static void op( CPU& cpu, const Instruction& instr )
+    {
+        cpu.cycles += NCycles;
+
+        if ( A == Def::ADDRESSING_IMMEDIATE && Def::writesMemory( Def::Mnemonic( M ) ) ) {
+            // no address to write to, nothing is accessed
+            cpu.pc -= instr.nOperands + 1;
+            cpu.raise( Fault::NotImplemented, instr.opcode );
+            return;
+        }
+
+        switch ( M )
+        {
+        case Def::MNEMONIC_ILL:
+            // jammed on it
+            cpu.pc -= instr.nOperands + 1;
+            cpu.raise( Fault::IllegalInstruction, instr.opcode );
+            break;
+        case Def::MNEMONIC_JMP: {
+            uint16_t adr = (instr.operand2 << 8) + instr.operand1;
+            if ( A == Def::ADDRESSING_INDIRECT ) {
+                // the low byte of the indirect pointer wraps around
+                uint16_t t2 = (adr & 0xFF00) | (uint8_t((adr & 0xff) + 1));
+                adr = cpu.readMem8<P>( adr ) | (cpu.readMem8<P>( t2 ) << 8);
+            }
+            cpu.pc = adr;
+            break;
+        }
+        case Def::MNEMONIC_LDA:
+            cpu.regA = operand<P, A>( cpu, instr );
+            updateNZ( cpu, cpu.regA );
+            break;
+        case Def::MNEMONIC_LDX:
+            cpu.regX = operand<P, A>( cpu, instr );
+            updateNZ( cpu, cpu.regX );
+            break;
+        case Def::MNEMONIC_LDY:
+            cpu.regY = operand<P, A>( cpu, instr );
+            updateNZ( cpu, cpu.regY );
+            break;
+        case Def::MNEMONIC_STA:
+            cpu.writeMem8<P>( address<P, A, false>( cpu, instr ), cpu.regA );
+            break;
+        case Def::MNEMONIC_STX:
+            cpu.writeMem8<P>( address<P, A, false>( cpu, instr ), cpu.regX );
+            break;
+        case Def::MNEMONIC_STY:
+            cpu.writeMem8<P>( address<P, A, false>( cpu, instr ), cpu.regY );
+            break;
+        case Def::MNEMONIC_JSR:
+            cpu.push<P>( cpu.pc - 1 );
+            cpu.pc = (instr.operand2 << 8) + instr.operand1;
+            break;
+        case Def::MNEMONIC_RTS:
+            cpu.pc = cpu.pop<P>() + 1;
+            break;
+        case Def::MNEMONIC_RTI:
+            // no B flag, bit 5 is always 1
+            cpu.status = (cpu.popByte<P>() & (0xFF - FLAG_B_MASK)) | FLAG_X_MASK;
+            cpu.pc = cpu.pop<P>();
+            break;
+        case Def::MNEMONIC_BCS:
+            branch( cpu, instr, cpu.status & FLAG_C_MASK );
+            break;
+        case Def::MNEMONIC_BCC:
+            branch( cpu, instr, !(cpu.status & FLAG_C_MASK) );
+            break;
+        case Def::MNEMONIC_BEQ:
+            branch( cpu, instr, cpu.status & FLAG_Z_MASK );
+            break;
+        case Def::MNEMONIC_BNE:
+            branch( cpu, instr, !(cpu.status & FLAG_Z_MASK) );
+            break;
+        case Def::MNEMONIC_BVS:
+            branch( cpu, instr, cpu.status & FLAG_V_MASK );
+            break;
+        case Def::MNEMONIC_BVC:
+            branch( cpu, instr, !(cpu.status & FLAG_V_MASK) );
+            break;
+        case Def::MNEMONIC_BPL:
+            branch( cpu, instr, !(cpu.status & FLAG_N_MASK) );
+            break;
+        case Def::MNEMONIC_BMI:
+            branch( cpu, instr, cpu.status & FLAG_N_MASK );
+            break;
+        case Def::MNEMONIC_SEC:
+            cpu.status |= FLAG_C_MASK;
+            break;
+        case Def::MNEMONIC_CLC:
+            cpu.status &= (0xFF - FLAG_C_MASK);
+            break;
+        case Def::MNEMONIC_SED:
+            cpu.status |= FLAG_D_MASK;
+            break;
+        case Def::MNEMONIC_CLD:
+            cpu.status &= (0xFF - FLAG_D_MASK);
+            break;
+        case Def::MNEMONIC_CLV:
+            cpu.status &= (0xFF - FLAG_V_MASK);
+            break;
+        case Def::MNEMONIC_SEI:
+            cpu.status |= FLAG_I_MASK;
+            break;
+        case Def::MNEMONIC_CLI:
+            cpu.status &= (0xFF - FLAG_I_MASK);
+            break;
+        case Def::MNEMONIC_BIT: {
+            uint8_t src = operand<P, A>( cpu, instr );
+            cpu.status &= (0xFF - FLAG_N_MASK - FLAG_V_MASK - FLAG_Z_MASK);
+            cpu.status |= (src & (FLAG_N_MASK | FLAG_V_MASK)) | ((src & cpu.regA) ? 0 : FLAG_Z_MASK);
+            break;
+        }
+        case Def::MNEMONIC_PHP:
+            // B flag and bit 5 are 1 when pushed
+            cpu.pushByte<P>( cpu.status | FLAG_B_MASK | FLAG_X_MASK );
+            break;
+        case Def::MNEMONIC_PHA:
+            cpu.pushByte<P>( cpu.regA );
+            break;
+        case Def::MNEMONIC_PLA:
+            cpu.regA = cpu.popByte<P>();
+            updateNZ( cpu, cpu.regA );
+            break;
+        case Def::MNEMONIC_PLP:
+            cpu.status = (cpu.popByte<P>() & (0xFF - FLAG_B_MASK)) | FLAG_X_MASK;
+            break;
+        case Def::MNEMONIC_AND:
+            cpu.instr_and( instr, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_ORA:
+            cpu.instr_ora( instr, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_EOR:
+            cpu.instr_eor( instr, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_CMP:
+            compare( cpu, cpu.regA, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_CPX:
+            compare( cpu, cpu.regX, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_CPY:
+            compare( cpu, cpu.regY, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_ADC:
+            cpu.instr_adc( instr, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_SBC:
+            cpu.instr_sbc( instr, operand<P, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_INC:
+            increment<P, A, 1>( cpu, instr );
+            break;
+        case Def::MNEMONIC_DEC:
+            increment<P, A, -1>( cpu, instr );
+            break;
+        case Def::MNEMONIC_INX:
+            updateNZ( cpu, ++cpu.regX );
+            break;
+        case Def::MNEMONIC_INY:
+            updateNZ( cpu, ++cpu.regY );
+            break;
+        case Def::MNEMONIC_DEX:
+            updateNZ( cpu, --cpu.regX );
+            break;
+        case Def::MNEMONIC_DEY:
+            updateNZ( cpu, --cpu.regY );
+            break;
+        case Def::MNEMONIC_TAX:
+            cpu.regX = cpu.regA;
+            updateNZ( cpu, cpu.regX );
+            break;
+        case Def::MNEMONIC_TAY:
+            cpu.regY = cpu.regA;
+            updateNZ( cpu, cpu.regY );
+            break;
+        case Def::MNEMONIC_TXA:
+            cpu.regA = cpu.regX;
+            updateNZ( cpu, cpu.regA );
+            break;
+        case Def::MNEMONIC_TYA:
+            cpu.regA = cpu.regY;
+            updateNZ( cpu, cpu.regA );
+            break;
+        case Def::MNEMONIC_TSX:
+            cpu.regX = cpu.sp;
+            updateNZ( cpu, cpu.regX );
+            break;
+        case Def::MNEMONIC_TXS:
+            cpu.sp = cpu.regX;
+            break;
+        case Def::MNEMONIC_ASL:
+        case Def::MNEMONIC_ROL:
+        case Def::MNEMONIC_LSR:
+        case Def::MNEMONIC_ROR:
+            modify<P, M, A>( cpu, instr );
+            break;
+        case Def::MNEMONIC_LAX:
+            cpu.regA = cpu.regX = operand<P, A>( cpu, instr );
+            updateNZ( cpu, cpu.regA );
+            break;
+        case Def::MNEMONIC_SAX:
+            cpu.writeMem8<P>( address<P, A, false>( cpu, instr ), cpu.regA & cpu.regX );
+            break;
+        case Def::MNEMONIC_DCP:
+            compare( cpu, cpu.regA, increment<P, A, -1>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_ISC:
+            cpu.instr_sbc( instr, increment<P, A, 1>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_SLO:
+            cpu.instr_ora( instr, modify<P, M, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_RLA:
+            cpu.instr_and( instr, modify<P, M, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_SRE:
+            cpu.instr_eor( instr, modify<P, M, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_RRA:
+            cpu.instr_adc( instr, modify<P, M, A>( cpu, instr ) );
+            break;
+        case Def::MNEMONIC_NOP:
+            // Do nothing, but resolve addressing (for cycles)
+            operand<P, A>( cpu, instr );
+            break;
+        default:
+            cpu.pc -= instr.nOperands + 1;
+            cpu.raise( Fault::NotImplemented, instr.opcode );
+        }
+    }
+};
+
+template <class Policy>
+const InstructionHandler* CPU::handlers()
+{
+#define DEF_HANDLER( opcode, mnemonic, addressing, ncycles ) \
+    &ThreadedOps::op<Policy, InstructionDefinition::mnemonic, InstructionDefinition::addressing, ncycles>,
+
+    static const InstructionHandler handlers_[256] = {
+        NES_OPCODES( DEF_HANDLER )
+    };
+
+#undef DEF_HANDLER
+    return handlers_;
+}
+
+template const InstructionHandler* CPU::handlers<ReleasePolicy>();
+template const InstructionHandler* CPU::handlers<DebugPolicy>();
@@ -0,0 +1,51 @@
+#ifndef NES_FRONTEND_HPP
+#define NES_FRONTEND_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Controller;
+
+///
+/// Video output and host input of the emulator
+///
+/// The emulation core only knows this interface, the window, the keyboard
+/// and the conversion to host colors live in the implementations.
+class Frontend
+{
+public:
+    virtual ~Frontend() {}
+
+    /// Display a frame of 256x240 palette indices (6 bits)
+    /// mask: value of the PPU Mask register (grayscale and color emphasis)
+    virtual void present( const uint8_t* screen, uint8_t mask ) = 0;
+
+    /// Play n audio samples (16-bit signed, mono, at the sample rate of
+    /// the APU), about one frame at a time
+    virtual void playAudio( const int16_t* samples, size_t n ) = 0;
+
+    enum Event
+    {
+        NoEvent,
+        // window closed or escape
+        QuitEvent,
+        // the user asks for the debugger
+        DebugEvent,
+        // the rewind key is held down
+        RewindEvent
+    };
+    /// Handle pending host events, updating the controller state
+    virtual Event poll( Controller& controller ) = 0;
+};
+
+///
+/// Frontend that displays nothing and reads no input, to run at full speed
+class NullFrontend : public Frontend
+{
+public:
+    void present( const uint8_t*, uint8_t ) {}
+    void playAudio( const int16_t*, size_t ) {}
+    Event poll( Controller& ) { return NoEvent; }
+};
+
+#endif
@@ -0,0 +1,276 @@
+// Runs a ROM for a number of frames without window nor input, as fast as
+// possible, and prints the final state
+//
+// --bench n runs n frames with a scripted input and prints the speed as
+// JSON, the reference measure of the performance changes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "console.hpp"
+#include "frontend.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+double now()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// FNV-1a of the palette indices of a frame
+uint64_t screenHash( const uint8_t* screen )
+{
+    uint64_t h = 1469598103934665603ULL;
+    for ( int i = 0; i < 256 * 240; i++ ) {
+        h = (h ^ screen[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// buttons held from a frame on, bit n for Controller button n
+typedef std::vector<std::pair<int, uint8_t> > InputScript;
+
+// Script file: one "frame buttons" line per change, buttons among
+// a b s(elect) t (start) u d l r, or - for none, # for comments
+bool readScript( const std::string& path, InputScript& script )
+{
+    std::ifstream file( path.c_str() );
+    if ( !file ) {
+        return false;
+    }
+    const std::string names( "abstudlr" );
+    std::string line;
+    while ( std::getline( file, line ) ) {
+        char buttons[16];
+        int frame;
+        if ( line.empty() || line[0] == '#' || sscanf( line.c_str(), "%d %15s", &frame, buttons ) != 2 ) {
+            continue;
+        }
+        uint8_t mask = 0;
+        for ( const char* c = buttons; *c; c++ ) {
+            size_t b = names.find( *c );
+            if ( b != std::string::npos ) {
+                mask |= 1 << b;
+            }
+        }
+        script.push_back( std::make_pair( frame, mask ) );
+    }
+    std::sort( script.begin(), script.end() );
+    return true;
+}
+
+// Default script: Start every 4 seconds, to leave the title screens,
+// and A every half second in between
+InputScript defaultScript( int frames )
+{
+    InputScript script;
+    for ( int f = 0; f < frames; f += 30 ) {
+        uint8_t button = f % 240 == 120 ? Controller::StartButton : Controller::AButton;
+        script.push_back( std::make_pair( f, uint8_t( 1 << button ) ) );
+        script.push_back( std::make_pair( f + 4, uint8_t( 0 ) ) );
+    }
+    return script;
+}
+
+// buttons of script at frame, from position next on
+void applyScript( const InputScript& script, size_t& next, int frame, Controller& controller )
+{
+    while ( next < script.size() && script[next].first <= frame ) {
+        for ( int b = 0; b < 8; b++ ) {
+            controller.setState( 0, b, (script[next].second >> b) & 1 );
+        }
+        next++;
+    }
+}
+
+std::string jsonString( const std::string& s )
+{
+    std::string r( "\"" );
+    for ( size_t i = 0; i < s.size(); i++ ) {
+        if ( s[i] == '"' || s[i] == '\\' ) {
+            r += '\\';
+        }
+        r += s[i];
+    }
+    return r + "\"";
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    int frames = 600;
+    bool interpreter = false;
+    bool useBlocks = true;
+    bool dotRenderer = false;
+    int runAhead = 0;
+    bool audio = true;
+    std::string profile;
+    std::string traceFile;
+    bool bench = false;
+    std::string inputFile;
+    std::vector<std::string> args;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--frames" && i + 1 < argc ) {
+            frames = atoi( argv[++i] );
+        }
+        else if ( arg == "--bench" && i + 1 < argc ) {
+            bench = true;
+            frames = atoi( argv[++i] );
+        }
+        else if ( arg == "--input" && i + 1 < argc ) {
+            inputFile = argv[++i];
+        }
+        else if ( arg == "--interpreter" ) {
+            interpreter = true;
+        }
+        else if ( arg == "--no-blocks" ) {
+            useBlocks = false;
+        }
+        else if ( arg == "--dot-renderer" ) {
+            dotRenderer = true;
+        }
+        else if ( arg == "--no-audio" ) {
+            audio = false;
+        }
+        else if ( arg == "--run-ahead" && i + 1 < argc ) {
+            runAhead = atoi( argv[++i] );
+        }
+        else if ( arg == "--profile" && i + 1 < argc ) {
+            profile = argv[++i];
+        }
+        else if ( arg == "--trace" && i + 1 < argc ) {
+            traceFile = argv[++i];
+        }
+        else {
+            args.push_back( arg );
+        }
+    }
+    if ( args.size() != 1 || frames <= 0 ) {
+        std::cerr << "Arguments: [--frames n | --bench n] [--input script] [--interpreter] [--no-blocks] [--dot-renderer] [--run-ahead n] [--no-audio] [--profile prefix] [--trace file] nes_file" << std::endl;
+        return 1;
+    }
+
+    if ( !traceFile.empty() && !Tracer::compiled() ) {
+        std::cerr << "--trace needs a build with NES_TRACE (cmake -DNES_TRACE=ON)" << std::endl;
+        return 1;
+    }
+
+    NullFrontend frontend;
+    Console console( &frontend );
+    console.setInterpreter( interpreter );
+    console.setBlocks( useBlocks );
+    if ( dotRenderer ) {
+        console.ppu().setRenderMode( PPU::RenderDot );
+    }
+    console.apu().setAudio( audio );
+
+    InputScript script;
+    if ( !inputFile.empty() ) {
+        if ( !readScript( inputFile, script ) ) {
+            std::cerr << inputFile << ": cannot read" << std::endl;
+            return 1;
+        }
+    }
+    else if ( bench ) {
+        script = defaultScript( frames );
+    }
+    size_t nextInput = 0;
+
+    // prefix.folded, prefix.opcodes, prefix.pcs and prefix.frames.csv
+    Profiler profiler;
+    FILE* frameLog = 0;
+    if ( !profile.empty() ) {
+        frameLog = fopen( (profile + ".frames.csv").c_str(), "w" );
+        if ( !frameLog ) {
+            std::cerr << profile << ".frames.csv: cannot write" << std::endl;
+            return 1;
+        }
+        profiler.setFrameLog( frameLog );
+        console.setProfiler( &profiler );
+    }
+
+    double start = 0;
+    try {
+        console.load( args[0] );
+        start = now();
+        Tracer::instance().setEnabled( !traceFile.empty() );
+        for ( int i = 0; i < frames && !console.cpu().stopped(); i++ ) {
+            applyScript( script, nextInput, i, console.controller() );
+            console.runFrameAhead( runAhead );
+            Tracer::instance().endFrame();
+        }
+    }
+    catch ( std::exception& e ) {
+        std::cerr << args[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if ( console.cpu().stopped() ) {
+        std::cerr << args[0] << ": " << console.cpu().fault() << std::endl;
+        return 1;
+    }
+    double elapsed = now() - start;
+
+    if ( !traceFile.empty() ) {
+        std::ofstream trace( traceFile.c_str() );
+        Tracer::instance().writeChromeTrace( trace );
+        Tracer::instance().writeSummary( std::cout );
+    }
+    if ( !profile.empty() ) {
+        fclose( frameLog );
+        std::ofstream folded( (profile + ".folded").c_str() );
+        profiler.writeCollapsed( folded );
+        std::ofstream opcodes( (profile + ".opcodes").c_str() );
+        profiler.writeOpcodes( opcodes );
+        std::ofstream pcs( (profile + ".pcs").c_str() );
+        profiler.writeHotspots( pcs, 100 );
+    }
+
+    const CPU& cpu = console.cpu();
+    if ( bench ) {
+        rusage usage;
+        getrusage( RUSAGE_SELF, &usage );
+        // the PPU runs 3 dots per CPU cycle
+        uint64_t dots = cpu.cycleCount * 3;
+        printf( "{\n" );
+        printf( "  \"rom\": %s,\n", jsonString( args[0] ).c_str() );
+        printf( "  \"frames\": %d,\n", frames );
+        printf( "  \"interpreter\": %s,\n", interpreter ? "true" : "false" );
+        printf( "  \"blocks\": %s,\n", useBlocks && !interpreter ? "true" : "false" );
+        printf( "  \"dot_renderer\": %s,\n", dotRenderer ? "true" : "false" );
+        printf( "  \"seconds\": %.6f,\n", elapsed );
+        printf( "  \"instructions\": %llu,\n", (unsigned long long)console.instructions() );
+        printf( "  \"cycles\": %llu,\n", (unsigned long long)cpu.cycleCount );
+        printf( "  \"ppu_dots\": %llu,\n", (unsigned long long)dots );
+        printf( "  \"mips\": %.3f,\n", console.instructions() / elapsed / 1e6 );
+        printf( "  \"ppu_dots_per_second\": %.0f,\n", dots / elapsed );
+        printf( "  \"fps\": %.1f,\n", frames / elapsed );
+        printf( "  \"ns_per_frame\": %.0f,\n", elapsed * 1e9 / frames );
+        printf( "  \"peak_rss_kb\": %ld,\n", usage.ru_maxrss );
+        printf( "  \"screen\": \"%016llx\"\n", (unsigned long long)screenHash( console.ppu().screen() ) );
+        printf( "}\n" );
+        return 0;
+    }
+    printf( "frames %d cycles %llu in %.1f ms (%.0f fps)\n", frames,
+            (unsigned long long)cpu.cycleCount, elapsed * 1000, frames / elapsed );
+    printf( "PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X screen:%016llx\n",
+            cpu.pc, cpu.regA, cpu.regX, cpu.regY, cpu.status, cpu.sp,
+            (unsigned long long)screenHash( console.ppu().screen() ) );
+    return 0;
+}
@@ -7,16 +7,10 @@
 #include <vector>
 #include <algorithm>
 
-#include "SDL.h"
-
-#include "nes_file_importer.hpp"
-#include "cpu.hpp"
-#include "ppu.hpp"
-#include "apu.hpp"
-#include "controller.hpp"
-
-#define MEM_SIZE 65536
-uint8_t* memory;
+#include "console.hpp"
+#include "rewind.hpp"
+#include "sdl_frontend.hpp"
+#include "trace.hpp"
 
 void print_context( CPU& cpu, uint16_t base, int n )
 {
@@ -30,6 +24,40 @@ void print_context( CPU& cpu, uint16_t base, int n )
     }
 }
 
+// "addr" or "first-last", in hexadecimal
+bool parse_range( const std::string& arg, uint16_t& first, uint16_t& last )
+{
+    unsigned int a, b;
+    int n = sscanf( arg.c_str(), "%x-%x", &a, &b );
+    if ( n < 1 ) {
+        return false;
+    }
+    first = a;
+    last = n == 2 ? b : a;
+    return true;
+}
+
+void print_watchpoints( const Watchpoints& watchpoints )
+{
+    const std::vector<Watchpoints::Range>& ranges = watchpoints.ranges();
+    for ( size_t i = 0; i < ranges.size(); i++ ) {
+        const Watchpoints::Range& r = ranges[i];
+        printf( "%-7s %04X-%04X hits %llu\n", Watchpoints::kindName( r.kind ), r.first, r.last,
+                (unsigned long long)r.hits );
+    }
+}
+
+// print and clear the fault that stopped the CPU, if any
+bool report_fault( CPU& cpu )
+{
+    if ( !cpu.stopped() ) {
+        return false;
+    }
+    std::cout << cpu.fault() << std::endl;
+    cpu.clearFault();
+    return true;
+}
+
 class Command
 {
 public:
@@ -65,120 +93,124 @@ private:
 
 int main( int argc, char *argv[] )
 {
-    iNESHeader header;
+    // use the switch based interpreter instead of the threaded dispatch
+    bool interpreter = false;
+    // run basic blocks of ROM code in one call (threaded dispatch only)
+    bool useBlocks = true;
+    // render tick by tick instead of scanline by scanline
+    bool dotRenderer = false;
+    // frames emulated ahead of the displayed one
+    int runAhead = 0;
+    // Chrome trace of the host time, written on exit
+    std::string traceFile;
+    std::vector<std::string> args;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--interpreter" ) {
+            interpreter = true;
+            useBlocks = false;
+        }
+        else if ( arg == "--no-blocks" ) {
+            useBlocks = false;
+        }
+        else if ( arg == "--dot-renderer" ) {
+            dotRenderer = true;
+        }
+        else if ( arg == "--run-ahead" && i + 1 < argc ) {
+            runAhead = atoi( argv[++i] );
+        }
+        else if ( arg == "--trace" && i + 1 < argc ) {
+            traceFile = argv[++i];
+        }
+        else {
+            args.push_back( arg );
+        }
+    }
 
-    if ( argc < 2 ) {
-        std::cerr << "Arguments: nes_file [log_file]" << std::endl;
+    if ( args.size() < 1 ) {
+        std::cerr << "Arguments: [--interpreter] [--no-blocks] [--dot-renderer] [--run-ahead n] [--trace file] nes_file [log_file]" << std::endl;
+        return 1;
+    }
+    bool testMode = args.size() > 1;
+    if ( !traceFile.empty() && !Tracer::compiled() ) {
+        std::cerr << "--trace needs a build with NES_TRACE (cmake -DNES_TRACE=ON)" << std::endl;
         return 1;
     }
-    bool testMode = argc > 2;
-
-    std::string nesFilePath = argv[1];
-    std::ifstream nesFile( nesFilePath.c_str() );
-
-    nesFile.read( (char*)&header, sizeof( header ) );
 
-    std::cout << header << std::endl;
+    std::string nesFilePath = args[0];
 
     const uint16_t baseAddr = 0xC000;
-    std::vector<uint8_t> mem(MEM_SIZE);
-    memory = &mem[0];
-    memset( memory, 0xFF, MEM_SIZE );
-
-    std::vector<uint8_t> rom(16384 * header.PRGRomSize);
-    nesFile.read( (char*)&rom[0], 16384 * header.PRGRomSize);
-
-    InstructionDefinition::initTable();
-
-    // init SDL
-    SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
-
-    CPU cpu;
-
-    cpu.pc = baseAddr;
-    cpu.sp = 0xFD;
-    cpu.status = 0x24;
-    cpu.regA = 0;
-    cpu.regX = 0;
-    cpu.regY = 0;
-    cpu.memory = memory;
-    cpu.cycles = 0;
-
-    ROM romDevice( rom.size(), &rom[0] );
-    RAM ramDevice( 2048 );
-    Controller controller;
-    PPU ppu( &cpu );
-    APU apu( &cpu, &controller );
-
-    cpu.addOnBus( 0x0000, &ramDevice, 0x0000 );
-    cpu.addOnBus( 0x0800, &ramDevice, 0x0800 );
-    cpu.addOnBus( 0x1000, &ramDevice, 0x1000 );
-    cpu.addOnBus( 0x1800, &ramDevice, 0x1800 );
-    uint16_t romAddr = 0x10000 - rom.size();
-    cpu.addOnBus( romAddr, &romDevice, romAddr );
-    for ( int i = 0; i < 0x2000 / 8; i += 8 ) {
-        cpu.addOnBus( 0x2000+i, &ppu, 0x2000+i );
-    }
-    cpu.addOnBus( 0x4000, &apu, 0x4000 );
 
-    // load CHR
-    nesFile.read( (char*)&ppu.memory()[0], 8192 );
+    SDLFrontend frontend;
+    Console console( &frontend );
+    console.setInterpreter( interpreter );
+    console.setBlocks( useBlocks );
+    if ( dotRenderer ) {
+        console.ppu().setRenderMode( PPU::RenderDot );
+    }
+    try {
+        console.load( nesFilePath );
+    }
+    catch ( std::runtime_error& e ) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << console.header() << std::endl;
+    if ( frontend.sampleRate() ) {
+        console.apu().setSampleRate( frontend.sampleRate() );
+    }
 
-    cpu.reset();
+    CPU& cpu = console.cpu();
+    PPU& ppu = console.ppu();
+    Controller& controller = console.controller();
 
     bool stepMode = true;
 
     // compare to log file
     std::ifstream logFile;
     if ( testMode ) {
-        std::string logFilePath = argv[2];
+        std::string logFilePath = args[1];
         logFile.open( logFilePath.c_str() );
+        // the automated mode of nestest starts at $C000
+        cpu.pc = baseAddr;
     }
 
     bool pause = false;
-    uint16_t breakAddr = 0;
-    bool breakMode = false;
     bool breakOnFrame = false;
+    // the instruction at pc has an execute watch, and the debugger stopped
+    // before it: run it alone before going on
+    bool atBreakpoint = false;
+    Watchpoints& watchpoints = cpu.watchpoints();
+    Rewind rewind;
+    uint64_t lastFrame = ppu.frameCount();
+    Tracer& tracer = Tracer::instance();
+    tracer.setEnabled( !traceFile.empty() );
     while ( true ) {
 
-        SDL_Event e;
-        if ( SDL_PollEvent(&e) ) {
-            if ( e.type == SDL_QUIT ) {
+        // host events, once per frame
+        if ( ppu.frameCount() != lastFrame ) {
+            lastFrame = ppu.frameCount();
+            tracer.endFrame();
+            console.apu().flush();
+            console.apu().setRateRatio( frontend.audioRateRatio() );
+            Frontend::Event e;
+            {
+                NES_TRACE_SCOPE( Poll );
+                e = frontend.poll( controller );
+            }
+            if ( e == Frontend::QuitEvent ) {
                 break;
             }
-            else if ( e.type == SDL_KEYDOWN || e.type == SDL_KEYUP ) {
-                SDL_KeyboardEvent* ke = (SDL_KeyboardEvent*)(&e);
-                bool pressed = ke->state == SDL_PRESSED;
-                if ( ke->keysym.sym == SDLK_ESCAPE ) {
-                    break;
-                }
-                else if ( ke->keysym.sym == SDLK_RETURN ) {
-                    controller.setState( 0, Controller::StartButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_SPACE ) {
-                    controller.setState( 0, Controller::SelectButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_RIGHT ) {
-                    controller.setState( 0, Controller::RightButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_LEFT ) {
-                    controller.setState( 0, Controller::LeftButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_UP ) {
-                    controller.setState( 0, Controller::UpButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_DOWN ) {
-                    controller.setState( 0, Controller::DownButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_a ) {
-                    controller.setState( 0, Controller::AButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_b ) {
-                    controller.setState( 0, Controller::BButton, pressed );
-                }
-                else if ( ke->keysym.sym == SDLK_d && pressed ) {
-                    pause = true;
-                }
+            else if ( e == Frontend::DebugEvent ) {
+                pause = true;
+            }
+            else if ( e == Frontend::RewindEvent && rewind.rewind( console ) ) {
+                // the restored frame is displayed once it is run again
+                lastFrame = ppu.frameCount();
+            }
+            else if ( !testMode ) {
+                NES_TRACE_SCOPE( Rewind );
+                rewind.record( console );
             }
         }
 
@@ -214,15 +246,8 @@ int main( int argc, char *argv[] )
         if ( stepMode ) {
             pause = true;
         }
-        if ( breakMode && breakAddr == cpu.pc ) {
-            printf("Breakpoint\n");
-            pause = true;
-        }
-        if ( breakOnFrame && ppu.ticks() == 0 && ppu.scanline() == 0 ) {
-            printf("Break on PPU frame\n");
-            pause = true;
-        }
         if ( pause ) {
+            ppu.sync();
             print_context( cpu, cpu.pc, 4 );
 
             printf("\tA:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%d\n", cpu.regA, cpu.regX, cpu.regY, cpu.status, cpu.sp, ppu.ticks() );
@@ -244,20 +269,26 @@ int main( int argc, char *argv[] )
                     pause = false;
                     break;
                 case 'b': { // breakpoint
+                    uint16_t first, last;
                     if ( command.name() == "bf" ) { // break on next video frame
                         breakOnFrame = true;
                     }
                     else if ( command.name() == "bdf" ) { // disable break on frame
                         breakOnFrame = false;
                     }
-                    else if ( command.name() == "bd" ) { // disable breakpoint
-                        breakMode = false;
+                    else if ( command.name() == "bd" ) { // disable breakpoints
+                        if ( command.n_args() == 0 ) {
+                            watchpoints.clear( Watchpoints::Execute );
+                        }
+                        else if ( parse_range( command.arg(0), first, last ) ) {
+                            watchpoints.remove( Watchpoints::Execute, first, last );
+                        }
+                    }
+                    else if ( command.name() == "bl" ) { // list
+                        print_watchpoints( watchpoints );
                     }
-                    else {
-                        breakMode = true;
-                        unsigned int b;
-                        sscanf( command.arg(0).c_str(), "%04X", &b );
-                        breakAddr = b;
+                    else if ( command.n_args() == 1 && parse_range( command.arg(0), first, last ) ) {
+                        watchpoints.add( Watchpoints::Execute, first, last );
                     }
                     doContinue = true;
                     break;
@@ -335,32 +366,81 @@ int main( int argc, char *argv[] )
                     doContinue = true;
                     break;
                 }
-                case 'w': // watch
-                    if ( command.n_args() < 2 ) {
-                        printf("w addr r|w: add read/write watch\n");
-                        doContinue = true;
+                case 'w': { // watch
+                    doContinue = true;
+                    uint16_t first = 0, last = 0xFFFF;
+                    bool remove = command.name() == "wd";
+                    if ( command.name() == "wl" ) {
+                        print_watchpoints( watchpoints );
                         break;
                     }
-                    unsigned int addr;
-                    sscanf( command.arg(0).c_str(), "%04X", &addr );
-                    if ( command.arg(1)[0] == 'r' ) {
-                        cpu.addReadWatch( addr );
+                    std::string kinds = command.n_args() >= 2 ? command.arg(1) : "rw";
+                    if ( (!remove && command.n_args() < 2) ||
+                         (command.n_args() >= 1 && !parse_range( command.arg(0), first, last )) ||
+                         kinds.empty() || kinds.find_first_not_of( "rwx" ) != std::string::npos ) {
+                        printf("w addr[-last] r|w|x: add a read/write/execute watch\n");
+                        printf("wd [addr[-last] [r|w|x]]: remove watches\n");
+                        printf("wl: list the watches and breakpoints\n");
+                        break;
                     }
-                    else {
-                        cpu.addWriteWatch( addr );
+                    for ( size_t i = 0; i < kinds.size(); i++ ) {
+                        Watchpoints::Kind kind = kinds[i] == 'r' ? Watchpoints::Read :
+                                                 kinds[i] == 'w' ? Watchpoints::Write : Watchpoints::Execute;
+                        if ( remove ) {
+                            watchpoints.remove( kind, first, last );
+                        }
+                        else {
+                            watchpoints.add( kind, first, last );
+                        }
                     }
-                    doContinue = true;
                     break;
+                }
                 case 'q':
                     return 0;
                     break;
                 }
             } while ( doContinue );
+            atBreakpoint = watchpoints.test( Watchpoints::Execute, cpu.pc );
+        }
+
+        if ( !stepMode && !testMode && !atBreakpoint ) {
+            // the watches are only checked by the debug policy, switched
+            // between frames
+            console.setDebug( watchpoints.active() );
+            // whole frames, the input is read again after each
+            if ( watchpoints.active() ) {
+                console.runFrame();
+            }
+            else {
+                console.runFrameAhead( runAhead );
+            }
+            if ( report_fault( cpu ) ) {
+                pause = true;
+            }
+            else if ( breakOnFrame ) {
+                printf("Break on PPU frame\n");
+                pause = true;
+            }
+            continue;
+        }
+
+        atBreakpoint = false;
+        NES_TRACE_SCOPE( Debugger );
+        if ( cpu.irqPending() ) {
+            cpu.cycles = 0;
+            cpu.triggerIRQ();
+            cpu.cycleCount += cpu.cycles;
+            ppu.sync();
+            if ( cpu.cycleCount >= console.apu().nextEvent() ) {
+                console.apu().sync();
+            }
+            continue;
         }
 
+        // one instruction at a time under the debugger or the log comparison
         uint16_t cpu_pc = cpu.pc;
         Instruction instr = cpu.decode( cpu.pc );
-        
+
         if ( testMode ) {
             if ( (cpu_pc != addr ) ||
                  (cpu.regA != regA) ||
@@ -377,25 +457,36 @@ int main( int argc, char *argv[] )
 
         cpu.cycles = 0;
         cpu.pc += instr.nOperands + 1;
-        try {
-            cpu.execute( instr );
+        if ( interpreter ) {
+            cpu.execute<DebugPolicy>( instr );
         }
-        catch ( CPU::ReadWatchTriggered& ) {
-            std::cout << "Read watch triggered" << std::endl;
-            pause = true;
+        else {
+            cpu.dispatch<DebugPolicy>( instr );
         }
-        catch ( CPU::WriteWatchTriggered& ) {
-            std::cout << "Write watch triggered" << std::endl;
-            pause = true;
+        if ( cpu.stopped() ) {
+            cpu.locateFault( cpu_pc );
+        }
+        cpu.cycleCount += cpu.cycles;
+        // keep the PPU in step for the debugger, and the APU for its
+        // interrupts, as Console::step does
+        ppu.sync();
+        if ( cpu.cycleCount >= console.apu().nextEvent() ) {
+            console.apu().sync();
         }
-        while ( cpu.cycles-- ) {
-            // ppu cycle
-            ppu.tick();
-            ppu.tick();
-            ppu.tick();
+        if ( report_fault( cpu ) ) {
+            pause = true;
+            if ( testMode ) {
+                break;
+            }
         }
     }
     std::cout << "End" << std::endl;
 
+    if ( !traceFile.empty() ) {
+        std::ofstream trace( traceFile.c_str() );
+        tracer.writeChromeTrace( trace );
+        tracer.writeSummary( std::cout );
+    }
+
     return 0;
 }
@@ -0,0 +1,389 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "mapper.hpp"
+
+Mapper::Mapper( int number, CPU* cpu, PPU* ppu, const NesFile& file,
+                PPU::Mirroring mirroring ) : cpu_( cpu ),
+                                             ppu_( ppu ),
+                                             mirroring_( mirroring ),
+                                             number_( number ),
+                                             prg_( file.prg() ),
+                                             prgSize_( file.prgSize() ),
+                                             chr_( file.chr() ),
+                                             chrSize_( file.chrSize() ),
+                                             prgRam_( 0x2000 )
+{
+    memset( regs_, 0, sizeof(regs_) );
+    memset( prgBanks_, 0, sizeof(prgBanks_) );
+    if ( chrSize_ == 0 ) {
+        chrRam_.assign( 0x2000, 0 );
+        chr_ = &chrRam_[0];
+        chrSize_ = chrRam_.size();
+    }
+}
+
+uint8_t Mapper::read( uint16_t addr ) const
+{
+    if ( addr >= 0x8000 ) {
+        return prgBanks_[(addr >> 13) & 3][addr & 0x1FFF];
+    }
+    // nothing on the expansion area
+    return 0;
+}
+
+void Mapper::write( uint16_t addr, uint8_t val )
+{
+    if ( addr >= 0x8000 ) {
+        writeRegister( addr, val );
+    }
+}
+
+uint8_t* Mapper::storage( uint16_t addr, size_t& size )
+{
+    if ( addr < 0x8000 || !prgBanks_[(addr >> 13) & 3] ) {
+        return 0;
+    }
+    size = 0x2000 - (addr & 0x1FFF);
+    return prgBanks_[(addr >> 13) & 3] + (addr & 0x1FFF);
+}
+
+void Mapper::mapPrg( uint16_t addr, size_t size, int bank )
+{
+    int count = int( std::max<size_t>( prgSize_ / size, 1 ) );
+    bank = (bank % count + count) % count;
+    size_t offset = size_t( bank ) * size;
+    for ( size_t i = 0; i < size; i += 0x2000 ) {
+        uint8_t* mem = prg_ + (offset + i) % prgSize_;
+        int window = ((addr - 0x8000 + i) >> 13) & 3;
+        if ( prgBanks_[window] != mem ) {
+            prgBanks_[window] = mem;
+            cpu_->remapBus( 0x8000 + window * 0x2000, 0x2000 );
+        }
+    }
+}
+
+void Mapper::mapChr( uint16_t addr, size_t size, int bank )
+{
+    int count = int( std::max<size_t>( chrSize_ / size, 1 ) );
+    bank = (bank % count + count) % count;
+    size_t offset = size_t( bank ) * size;
+    for ( size_t i = 0; i < size; i += 0x400 ) {
+        ppu_->mapPatterns( ((addr + i) >> 10) & 7, chr_ + (offset + i) % chrSize_, !chrRam_.empty() );
+    }
+}
+
+void Mapper::saveState( State& state ) const
+{
+    memcpy( state.regs, regs_, sizeof(state.regs) );
+    memcpy( state.prgRam, prgRam_.data(), sizeof(state.prgRam) );
+    if ( !chrRam_.empty() ) {
+        memcpy( state.chrRam, &chrRam_[0], sizeof(state.chrRam) );
+    }
+    else {
+        memset( state.chrRam, 0, sizeof(state.chrRam) );
+    }
+}
+
+void Mapper::loadState( const State& state )
+{
+    memcpy( regs_, state.regs, sizeof(regs_) );
+    memcpy( prgRam_.data(), state.prgRam, sizeof(state.prgRam) );
+    if ( !chrRam_.empty() ) {
+        memcpy( &chrRam_[0], state.chrRam, sizeof(state.chrRam) );
+    }
+    apply();
+}
+
+///
+/// Mapper 0: 16 or 32 KB of PRG ROM and 8 KB of CHR, no register
+class NROM : public Mapper
+{
+public:
+    NROM( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 0, cpu, ppu, file, mirroring )
+    {
+    }
+
+    void apply()
+    {
+        // a single 16 KB bank is mirrored at $C000
+        mapPrg( 0x8000, 0x8000, 0 );
+        mapChr( 0x0000, 0x2000, 0 );
+        setMirroring( mirroring_ );
+    }
+
+protected:
+    void writeRegister( uint16_t, uint8_t ) {}
+};
+
+///
+/// Mapper 1: serial port of 5 bits to 4 registers (control, 2 CHR banks
+/// and the PRG bank)
+class MMC1 : public Mapper
+{
+public:
+    MMC1( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 1, cpu, ppu, file, mirroring )
+    {
+        regs_[Shift] = 0x10;
+        // last PRG bank fixed at $C000
+        regs_[Control] = 0x0C;
+    }
+
+    void apply()
+    {
+        static const PPU::Mirroring mirrorings[4] = {
+            PPU::MirrorSingleLow, PPU::MirrorSingleHigh, PPU::MirrorVertical, PPU::MirrorHorizontal
+        };
+        uint8_t control = regs_[Control];
+        setMirroring( mirrorings[control & 3] );
+
+        // 512 KB boards select the 256 KB half with the CHR bank
+        int outer = prgSize() > 0x40000 ? (regs_[Chr0] & 0x10) : 0;
+        int prg = regs_[Prg] & 0x0F;
+        switch ( (control >> 2) & 3 ) {
+        case 0:
+        case 1:
+            mapPrg( 0x8000, 0x8000, (outer | prg) >> 1 );
+            break;
+        case 2:
+            mapPrg( 0x8000, 0x4000, outer );
+            mapPrg( 0xC000, 0x4000, outer | prg );
+            break;
+        case 3:
+            mapPrg( 0x8000, 0x4000, outer | prg );
+            mapPrg( 0xC000, 0x4000, outer | 0x0F );
+            break;
+        }
+
+        if ( control & 0x10 ) {
+            mapChr( 0x0000, 0x1000, regs_[Chr0] );
+            mapChr( 0x1000, 0x1000, regs_[Chr1] );
+        }
+        else {
+            mapChr( 0x0000, 0x2000, regs_[Chr0] >> 1 );
+        }
+    }
+
+protected:
+    enum { Shift, Control, Chr0, Chr1, Prg };
+
+    void writeRegister( uint16_t addr, uint8_t val )
+    {
+        if ( val & 0x80 ) {
+            regs_[Shift] = 0x10;
+            regs_[Control] |= 0x0C;
+            apply();
+            return;
+        }
+        // the bit of the first write reaches bit 0 on the fifth one
+        bool fifth = regs_[Shift] & 1;
+        uint8_t v = (regs_[Shift] >> 1) | ((val & 1) << 4);
+        if ( !fifth ) {
+            regs_[Shift] = v;
+            return;
+        }
+        regs_[Shift] = 0x10;
+        regs_[Control + ((addr >> 13) & 3)] = v;
+        apply();
+    }
+};
+
+///
+/// Mapper 2: 16 KB PRG bank at $8000, last bank fixed at $C000
+class UxROM : public Mapper
+{
+public:
+    UxROM( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 2, cpu, ppu, file, mirroring )
+    {
+    }
+
+    void apply()
+    {
+        mapPrg( 0x8000, 0x4000, regs_[0] );
+        mapPrg( 0xC000, 0x4000, -1 );
+        mapChr( 0x0000, 0x2000, 0 );
+        setMirroring( mirroring_ );
+    }
+
+protected:
+    void writeRegister( uint16_t, uint8_t val )
+    {
+        regs_[0] = val;
+        apply();
+    }
+};
+
+///
+/// Mapper 3: 8 KB CHR bank, fixed PRG
+class CNROM : public Mapper
+{
+public:
+    CNROM( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 3, cpu, ppu, file, mirroring )
+    {
+    }
+
+    void apply()
+    {
+        mapPrg( 0x8000, 0x8000, 0 );
+        mapChr( 0x0000, 0x2000, regs_[0] );
+        setMirroring( mirroring_ );
+    }
+
+protected:
+    void writeRegister( uint16_t, uint8_t val )
+    {
+        regs_[0] = val;
+        apply();
+    }
+};
+
+///
+/// Mapper 4: 8 KB PRG banks, 1 and 2 KB CHR banks and a scanline counter
+/// raising an IRQ
+class MMC3 : public Mapper
+{
+public:
+    MMC3( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 4, cpu, ppu, file, mirroring )
+    {
+    }
+
+    void apply()
+    {
+        const uint8_t* r = &regs_[Bank];
+        uint8_t select = regs_[Select];
+
+        // R6 at $8000 and the second last bank at $C000, swapped by bit 6
+        uint16_t swap = (select & 0x40) ? 0x4000 : 0;
+        mapPrg( 0x8000 ^ swap, 0x2000, r[6] );
+        mapPrg( 0xA000, 0x2000, r[7] );
+        mapPrg( 0xC000 ^ swap, 0x2000, -2 );
+        mapPrg( 0xE000, 0x2000, -1 );
+
+        // 2 KB banks R0 and R1 then 1 KB banks R2 to R5, halves swapped
+        // by bit 7
+        uint16_t invert = (select & 0x80) ? 0x1000 : 0;
+        mapChr( 0x0000 ^ invert, 0x800, r[0] >> 1 );
+        mapChr( 0x0800 ^ invert, 0x800, r[1] >> 1 );
+        for ( int i = 0; i < 4; i++ ) {
+            mapChr( (0x1000 + i * 0x400) ^ invert, 0x400, r[2 + i] );
+        }
+
+        if ( mirroring_ == PPU::MirrorFourScreen ) {
+            setMirroring( mirroring_ );
+        }
+        else {
+            setMirroring( regs_[Mirror] ? PPU::MirrorHorizontal : PPU::MirrorVertical );
+        }
+    }
+
+    bool countsScanlines() const { return true; }
+
+    void scanline()
+    {
+        if ( regs_[Counter] == 0 || regs_[Reload] ) {
+            regs_[Counter] = regs_[Latch];
+            regs_[Reload] = 0;
+        }
+        else {
+            regs_[Counter]--;
+        }
+        if ( regs_[Counter] == 0 && regs_[IrqEnabled] ) {
+            cpu_->setIRQ( CPU::IrqMapper, true );
+        }
+    }
+
+protected:
+    // Bank: R0 to R7
+    enum { Select, Bank, Mirror = Bank + 8, Latch, Counter, Reload, IrqEnabled };
+
+    void writeRegister( uint16_t addr, uint8_t val )
+    {
+        switch ( addr & 0xE001 ) {
+        case 0x8000:
+            regs_[Select] = val;
+            apply();
+            break;
+        case 0x8001:
+            regs_[Bank + (regs_[Select] & 7)] = val;
+            apply();
+            break;
+        case 0xA000:
+            regs_[Mirror] = val & 1;
+            apply();
+            break;
+        case 0xA001:
+            // PRG RAM protection, not emulated
+            break;
+        case 0xC000:
+            regs_[Latch] = val;
+            break;
+        case 0xC001:
+            regs_[Counter] = 0;
+            regs_[Reload] = 1;
+            break;
+        case 0xE000:
+            // also acknowledges the pending IRQ
+            regs_[IrqEnabled] = 0;
+            cpu_->setIRQ( CPU::IrqMapper, false );
+            break;
+        case 0xE001:
+            regs_[IrqEnabled] = 1;
+            break;
+        }
+    }
+};
+
+///
+/// Mapper 7: 32 KB PRG bank and single screen mirroring
+class AxROM : public Mapper
+{
+public:
+    AxROM( CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring ) :
+        Mapper( 7, cpu, ppu, file, mirroring )
+    {
+    }
+
+    void apply()
+    {
+        mapPrg( 0x8000, 0x8000, regs_[0] & 7 );
+        mapChr( 0x0000, 0x2000, 0 );
+        setMirroring( (regs_[0] & 0x10) ? PPU::MirrorSingleHigh : PPU::MirrorSingleLow );
+    }
+
+protected:
+    void writeRegister( uint16_t, uint8_t val )
+    {
+        regs_[0] = val;
+        apply();
+    }
+};
+
+Mapper* Mapper::create( const NesFile& file, CPU* cpu, PPU* ppu )
+{
+    const iNESHeader& header = file.header();
+    PPU::Mirroring mirroring = (header.flags6 & 8) ? PPU::MirrorFourScreen :
+        (header.flags6 & 1) ? PPU::MirrorVertical : PPU::MirrorHorizontal;
+    switch ( header.mapper() ) {
+    case 0:
+        return new NROM( cpu, ppu, file, mirroring );
+    case 1:
+        return new MMC1( cpu, ppu, file, mirroring );
+    case 2:
+        return new UxROM( cpu, ppu, file, mirroring );
+    case 3:
+        return new CNROM( cpu, ppu, file, mirroring );
+    case 4:
+        return new MMC3( cpu, ppu, file, mirroring );
+    case 7:
+        return new AxROM( cpu, ppu, file, mirroring );
+    }
+    throw std::runtime_error( "unsupported mapper " + std::to_string( header.mapper() ) );
+}
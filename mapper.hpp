@@ -0,0 +1,97 @@
+#ifndef NES_MAPPER_HPP
+#define NES_MAPPER_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "bus_device.hpp"
+#include "cpu.hpp"
+#include "ppu.hpp"
+#include "nes_file_importer.hpp"
+
+///
+/// Cartridge board: the PRG and CHR memories and their bank switching
+///
+/// The mapper covers $4020-$FFFF on the CPU bus, except the PRG RAM at
+/// $6000-$7FFF which is a plain RAM device. Its registers are written in
+/// the ROM area.
+///
+/// The PRG ROM is seen through four windows of 8 KB at $8000. A bank
+/// switch changes the pointer of a window and refreshes the 32 bus pages
+/// of this window, whatever the size of the ROM: nothing is copied. The
+/// CHR banks are switched the same way, by pointer, in the PPU.
+///
+/// The ROMs are used in place, in the mapped file which must outlive the
+/// mapper.
+class Mapper : public BusDevice
+{
+public:
+    /// Board given by the iNES header of the file
+    /// Throws std::runtime_error for the unsupported ones
+    static Mapper* create( const NesFile& file, CPU* cpu, PPU* ppu );
+    virtual ~Mapper() {}
+
+    /// iNES mapper number
+    int number() const { return number_; }
+
+    RAM& prgRam() { return prgRam_; }
+
+    /// Map the banks selected by the registers (once the mapper is on the
+    /// bus, and after each register change)
+    virtual void apply() = 0;
+
+    uint8_t read( uint16_t addr ) const;
+    void write( uint16_t addr, uint8_t val );
+    uint8_t* storage( uint16_t addr, size_t& size );
+
+    /// true if scanline() must be called at the end of each rendered line
+    virtual bool countsScanlines() const { return false; }
+    virtual void scanline() {}
+
+    /// Saved state
+    struct State
+    {
+        uint8_t regs[16];
+        uint8_t prgRam[0x2000];
+        uint8_t chrRam[0x2000];
+    };
+    void saveState( State& state ) const;
+    /// Restore the registers and the RAMs, then the banks they select
+    void loadState( const State& state );
+
+protected:
+    Mapper( int number, CPU* cpu, PPU* ppu, const NesFile& file, PPU::Mirroring mirroring );
+
+    // write to a register, somewhere in $8000-$FFFF
+    virtual void writeRegister( uint16_t addr, uint8_t val ) = 0;
+
+    // Map bank number bank, of size bytes, at addr. Banks are counted in
+    // units of size, from the end when negative, modulo the memory size.
+    void mapPrg( uint16_t addr, size_t size, int bank );
+    void mapChr( uint16_t addr, size_t size, int bank );
+    void setMirroring( PPU::Mirroring mirroring ) { ppu_->setMirroring( mirroring ); }
+
+    size_t prgSize() const { return prgSize_; }
+
+    CPU* cpu_;
+    PPU* ppu_;
+    // registers, as plain bytes for the save states
+    // set to their power on values by the constructors
+    uint8_t regs_[16];
+    // mirroring of the boards that cannot change it
+    PPU::Mirroring mirroring_;
+
+private:
+    int number_;
+    uint8_t* prg_;
+    size_t prgSize_;
+    // CHR ROM in the file, or chrRam_
+    uint8_t* chr_;
+    size_t chrSize_;
+    std::vector<uint8_t> chrRam_;
+    RAM prgRam_;
+    // 8 KB windows of $8000-$FFFF
+    uint8_t* prgBanks_[4];
+};
+
+#endif
@@ -0,0 +1,532 @@
+// Micro-benchmarks of the CPU, bus and PPU kernels
+//
+// Usage: nes_microbench [--reps n] [--filter text] [--json file]
+//                       [--baseline file] [--threshold percent] [nes_file]
+//
+// Each kernel is warmed up, then timed over --reps repetitions of about
+// 10 ms, and reported as the median, minimum, mean and standard deviation
+// of the time per item (byte, instruction, dot, ...). --json writes the
+// results, --baseline compares them to a previous --json file and fails
+// if a kernel is slower by more than --threshold percent (10 by default).
+// The comparison is on the minimum, the least disturbed by the rest of
+// the machine.
+// The CPU and PPU kernels run on the given ROM (data/nestest.nes by
+// default).
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "console.hpp"
+#include "frontend.hpp"
+#include "palette.hpp"
+#include "tile_decoder.hpp"
+
+///
+/// Access to the private kernels of the PPU
+struct MicroBench
+{
+    // sprites of the scanline after line
+    static void evaluateSprites( PPU& ppu, int line )
+    {
+        int scanline = ppu.scanline_;
+        ppu.scanline_ = line;
+        ppu.evaluateSprites();
+        ppu.scanline_ = scanline;
+    }
+};
+
+namespace
+{
+
+double now()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// register without storage, the bus goes through read/write
+class Latch : public BusDevice
+{
+public:
+    Latch() : value_( 0 ) {}
+    uint8_t read( uint16_t ) const { return value_; }
+    void write( uint16_t, uint8_t val ) { value_ = val; }
+private:
+    uint8_t value_;
+};
+
+///
+/// What the kernels run on
+struct Fixture
+{
+    Fixture( const std::string& nesFile ) : console( &frontend ),
+                                            ram( 2048 ),
+                                            prg( 0x8000 ),
+                                            rom( prg.size(), &prg[0] ),
+                                            screen( 256 * 240 ),
+                                            pixels( 256 * 240 ),
+                                            chr( 8192 )
+    {
+        console.load( nesFile );
+
+        // the memory map of the console, alone
+        map.insert( 0x0000, &ram, 0x0000 );
+        map.insert( 0x0800, &ram, 0x0800 );
+        map.insert( 0x1000, &ram, 0x1000 );
+        map.insert( 0x1800, &ram, 0x1800 );
+        map.insert( 0x2000, &latch, 0 );
+        map.insert( 0x8000, &rom, 0 );
+
+        srand( 1 );
+        for ( size_t i = 0; i < prg.size(); i++ ) {
+            prg[i] = rand();
+        }
+        for ( size_t i = 0; i < screen.size(); i++ ) {
+            screen[i] = rand() & 0x3F;
+        }
+        for ( size_t i = 0; i < chr.size(); i++ ) {
+            chr[i] = rand();
+        }
+        buildColorTable( 0, colors );
+        PPU& ppu = console.ppu();
+
+        // operands of the addressing modes: pointer at $10 to $0200
+        CPU& cpu = console.cpu();
+        cpu.writeMem8<ReleasePolicy>( 0x10, 0x00 );
+        cpu.writeMem8<ReleasePolicy>( 0x11, 0x02 );
+        cpu.regX = 1;
+        cpu.regY = 1;
+
+        // groups of 8 sprites every 24 lines, a full scanline on the
+        // 8 lines of each group
+        ppu.write( PPU::OAMAddr, 0 );
+        for ( int i = 0; i < 64; i++ ) {
+            ppu.write( PPU::OAMData, (i / 8) * 24 );
+            ppu.write( PPU::OAMData, i );
+            ppu.write( PPU::OAMData, i & 0xC3 );
+            ppu.write( PPU::OAMData, i * 4 );
+        }
+        // background and sprites on, no NMI
+        ppu.write( PPU::PPUCtrl, 0 );
+        ppu.write( PPU::PPUMask, 0x1E );
+    }
+
+    NullFrontend frontend;
+    Console console;
+
+    MemoryMap map;
+    RAM ram;
+    Latch latch;
+    std::vector<uint8_t> prg;
+    ROM rom;
+
+    std::vector<uint8_t> screen;
+    std::vector<uint32_t> pixels;
+    uint32_t colors[64];
+    std::vector<uint8_t> chr;
+};
+
+// Runs n items, returns a checksum that keeps the results alive
+typedef uint64_t (*Kernel)( Fixture& f, long n );
+
+struct Benchmark
+{
+    const char* name;
+    // time per item
+    const char* unit;
+    Kernel kernel;
+};
+
+uint64_t busReadRam( Fixture& f, long n )
+{
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        check += f.map.read( i & 0x1FFF );
+    }
+    return check;
+}
+
+uint64_t busReadRom( Fixture& f, long n )
+{
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        check += f.map.read( 0x8000 | (i & 0x7FFF) );
+    }
+    return check;
+}
+
+uint64_t busReadRegister( Fixture& f, long n )
+{
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        check += f.map.read( 0x2000 | (i & 7) );
+    }
+    return check;
+}
+
+uint64_t busWriteRam( Fixture& f, long n )
+{
+    for ( long i = 0; i < n; i++ ) {
+        f.map.write( i & 0x1FFF, i );
+    }
+    return f.map.read( 0 );
+}
+
+uint64_t busWriteRegister( Fixture& f, long n )
+{
+    for ( long i = 0; i < n; i++ ) {
+        f.map.write( 0x2000 | (i & 7), i );
+    }
+    return f.map.read( 0x2000 );
+}
+
+uint64_t decode( Fixture& f, long n )
+{
+    const CPU& cpu = f.console.cpu();
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        Instruction instr = cpu.decode( 0x8000 | (i & 0x7FFF) );
+        check += instr.nOperands;
+    }
+    return check;
+}
+
+// n LDA with the addressing mode of opcode, operand $10 or $0200
+uint64_t resolve( Fixture& f, long n, uint8_t opcode )
+{
+    CPU& cpu = f.console.cpu();
+    Instruction instr;
+    instr.opcode = opcode;
+    instr.def = &InstructionDefinition::table()[opcode];
+    instr.addressing = instr.def->addressing;
+    instr.nOperands = instr.def->nOperands;
+    instr.operand1 = instr.nOperands == 2 ? 0x00 : 0x10;
+    instr.operand2 = 0x02;
+    instr.valid = true;
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        check += cpu.resolveAddressing<ReleasePolicy>( instr );
+    }
+    cpu.cycles = 0;
+    return check;
+}
+
+uint64_t resolveImmediate( Fixture& f, long n ) { return resolve( f, n, 0xA9 ); }
+uint64_t resolveZeroPage( Fixture& f, long n ) { return resolve( f, n, 0xA5 ); }
+uint64_t resolveZeroPageX( Fixture& f, long n ) { return resolve( f, n, 0xB5 ); }
+uint64_t resolveAbsolute( Fixture& f, long n ) { return resolve( f, n, 0xAD ); }
+uint64_t resolveAbsoluteX( Fixture& f, long n ) { return resolve( f, n, 0xBD ); }
+uint64_t resolveAbsoluteY( Fixture& f, long n ) { return resolve( f, n, 0xB9 ); }
+uint64_t resolveIndirectX( Fixture& f, long n ) { return resolve( f, n, 0xA1 ); }
+uint64_t resolveIndirectY( Fixture& f, long n ) { return resolve( f, n, 0xB1 ); }
+
+// PPU::frame() on each dot, the dot renderer
+uint64_t ppuDot( Fixture& f, long n )
+{
+    PPU& ppu = f.console.ppu();
+    for ( long i = 0; i < n; i++ ) {
+        ppu.tick();
+    }
+    return ppu.screen()[ppu.time() & 0xFFFF];
+}
+
+// the scanline renderer, per dot
+uint64_t ppuScanline( Fixture& f, long n )
+{
+    PPU& ppu = f.console.ppu();
+    ppu.setRenderMode( PPU::RenderScanline );
+    ppu.sync( ppu.time() + n );
+    ppu.setRenderMode( PPU::RenderDot );
+    return ppu.screen()[ppu.time() & 0xFFFF];
+}
+
+// per scanline
+uint64_t spriteEvaluation( Fixture& f, long n )
+{
+    PPU& ppu = f.console.ppu();
+    for ( long i = 0; i < n; i++ ) {
+        MicroBench::evaluateSprites( ppu, i % 240 );
+    }
+    return ppu.screen()[0];
+}
+
+// palette indices of a frame to host colors, per pixel
+uint64_t convert( Fixture& f, long n, ColorConverter converter )
+{
+    const size_t frame = f.screen.size();
+    for ( long done = 0; done < n; done += frame ) {
+        size_t k = std::min( size_t( n - done ), frame );
+        converter( &f.screen[0], k, f.colors, &f.pixels[0] );
+    }
+    return f.pixels[n % frame];
+}
+
+uint64_t convertDefault( Fixture& f, long n ) { return convert( f, n, convertToXRGB ); }
+uint64_t convertScalar( Fixture& f, long n ) { return convert( f, n, convertToXRGBScalar ); }
+#if defined(__x86_64__) || defined(__i386__)
+uint64_t convertAVX2( Fixture& f, long n ) { return convert( f, n, convertToXRGBAVX2 ); }
+#endif
+
+// CHR patterns to palette indices, per tile
+uint64_t decodeTiles( Fixture& f, long n, PatternDecoder decoder )
+{
+    const int nTiles = f.chr.size() / 16;
+    uint8_t out[64];
+    uint64_t check = 0;
+    for ( long i = 0; i < n; i++ ) {
+        decoder( &f.chr[(i % nTiles) * 16], out );
+        check += out[i & 63];
+    }
+    return check;
+}
+
+uint64_t tilesScalar( Fixture& f, long n ) { return decodeTiles( f, n, decodePatternScalar ); }
+uint64_t tilesTable( Fixture& f, long n ) { return decodeTiles( f, n, decodePatternTable ); }
+#if defined(__x86_64__) || defined(__i386__)
+uint64_t tilesSSE2( Fixture& f, long n ) { return decodeTiles( f, n, decodePatternSSE2 ); }
+uint64_t tilesAVX2( Fixture& f, long n ) { return decodeTiles( f, n, decodePatternAVX2 ); }
+#endif
+
+const Benchmark Benchmarks[] =
+{
+    { "bus_read_ram", "ns/read", busReadRam },
+    { "bus_read_rom", "ns/read", busReadRom },
+    { "bus_read_register", "ns/read", busReadRegister },
+    { "bus_write_ram", "ns/write", busWriteRam },
+    { "bus_write_register", "ns/write", busWriteRegister },
+    { "cpu_decode", "ns/instr", decode },
+    { "resolve_immediate", "ns/instr", resolveImmediate },
+    { "resolve_zero_page", "ns/instr", resolveZeroPage },
+    { "resolve_zero_page_x", "ns/instr", resolveZeroPageX },
+    { "resolve_absolute", "ns/instr", resolveAbsolute },
+    { "resolve_absolute_x", "ns/instr", resolveAbsoluteX },
+    { "resolve_absolute_y", "ns/instr", resolveAbsoluteY },
+    { "resolve_indirect_x", "ns/instr", resolveIndirectX },
+    { "resolve_indirect_y", "ns/instr", resolveIndirectY },
+    { "ppu_frame_dot", "ns/dot", ppuDot },
+    { "ppu_scanline_dot", "ns/dot", ppuScanline },
+    { "ppu_sprite_evaluation", "ns/line", spriteEvaluation },
+    { "render_palette", "ns/pixel", convertDefault },
+    { "render_palette_scalar", "ns/pixel", convertScalar },
+#if defined(__x86_64__) || defined(__i386__)
+    { "render_palette_avx2", "ns/pixel", convertAVX2 },
+#endif
+    { "tile_decode_scalar", "ns/tile", tilesScalar },
+    { "tile_decode_table", "ns/tile", tilesTable },
+#if defined(__x86_64__) || defined(__i386__)
+    { "tile_decode_sse2", "ns/tile", tilesSSE2 },
+    { "tile_decode_avx2", "ns/tile", tilesAVX2 },
+#endif
+};
+
+bool supported( const Benchmark& b )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if ( strstr( b.name, "avx2" ) && !__builtin_cpu_supports( "avx2" ) ) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    double median;
+    double min;
+    double mean;
+    double stddev;
+    int reps;
+};
+
+// warm-up: rates settle, caches fill and the decoded pages are built
+const double WarmUp = 0.05;
+// seconds per repetition
+const double Repetition = 0.01;
+
+Result measure( Fixture& f, const Benchmark& b, int reps, uint64_t& check )
+{
+    // warm up, doubling n until WarmUp is reached
+    long n = 1024;
+    double elapsed = 0;
+    while ( true ) {
+        double start = now();
+        check += b.kernel( f, n );
+        elapsed = now() - start;
+        if ( elapsed >= WarmUp ) {
+            break;
+        }
+        n *= 2;
+    }
+    n = std::max( long( n * Repetition / elapsed ), 1L );
+
+    std::vector<double> times( reps );
+    for ( int r = 0; r < reps; r++ ) {
+        double start = now();
+        check += b.kernel( f, n );
+        times[r] = (now() - start) * 1e9 / n;
+    }
+    std::sort( times.begin(), times.end() );
+
+    Result result;
+    result.name = b.name;
+    result.unit = b.unit;
+    result.reps = reps;
+    result.min = times[0];
+    result.median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+    double sum = 0;
+    for ( int r = 0; r < reps; r++ ) {
+        sum += times[r];
+    }
+    result.mean = sum / reps;
+    double var = 0;
+    for ( int r = 0; r < reps; r++ ) {
+        var += (times[r] - result.mean) * (times[r] - result.mean);
+    }
+    result.stddev = reps > 1 ? sqrt( var / (reps - 1) ) : 0;
+    return result;
+}
+
+// one benchmark per line, read back by readBaseline
+void writeJson( std::ostream& ostr, const std::vector<Result>& results )
+{
+    char line[256];
+    ostr << "{\"benchmarks\": [" << std::endl;
+    for ( size_t i = 0; i < results.size(); i++ ) {
+        const Result& r = results[i];
+        snprintf( line, sizeof(line),
+                  "  {\"name\": \"%s\", \"unit\": \"%s\", \"median\": %.4f, \"min\": %.4f, "
+                  "\"mean\": %.4f, \"stddev\": %.4f, \"reps\": %d}%s",
+                  r.name.c_str(), r.unit.c_str(), r.median, r.min, r.mean, r.stddev, r.reps,
+                  i + 1 < results.size() ? "," : "" );
+        ostr << line << std::endl;
+    }
+    ostr << "]}" << std::endl;
+}
+
+// minimums by name of a file of writeJson
+bool readBaseline( const std::string& path, std::map<std::string, double>& minimums )
+{
+    std::ifstream file( path.c_str() );
+    if ( !file ) {
+        return false;
+    }
+    std::string line;
+    while ( std::getline( file, line ) ) {
+        char name[64];
+        double min;
+        const char* p = strstr( line.c_str(), "\"name\": \"" );
+        const char* m = strstr( line.c_str(), "\"min\": " );
+        if ( p && m && sscanf( p, "\"name\": \"%63[^\"]\"", name ) == 1 &&
+             sscanf( m, "\"min\": %lf", &min ) == 1 ) {
+            minimums[name] = min;
+        }
+    }
+    return true;
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+    int reps = 15;
+    double threshold = 10;
+    std::string filter;
+    std::string jsonFile;
+    std::string baselineFile;
+    std::string nesFile( "data/nestest.nes" );
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--reps" && i + 1 < argc ) {
+            reps = std::max( atoi( argv[++i] ), 1 );
+        }
+        else if ( arg == "--filter" && i + 1 < argc ) {
+            filter = argv[++i];
+        }
+        else if ( arg == "--json" && i + 1 < argc ) {
+            jsonFile = argv[++i];
+        }
+        else if ( arg == "--baseline" && i + 1 < argc ) {
+            baselineFile = argv[++i];
+        }
+        else if ( arg == "--threshold" && i + 1 < argc ) {
+            threshold = atof( argv[++i] );
+        }
+        else if ( arg[0] == '-' ) {
+            std::cerr << "Arguments: [--reps n] [--filter text] [--json file] [--baseline file] [--threshold percent] [nes_file]" << std::endl;
+            return 1;
+        }
+        else {
+            nesFile = arg;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if ( !baselineFile.empty() && !readBaseline( baselineFile, baseline ) ) {
+        std::cerr << baselineFile << ": cannot read" << std::endl;
+        return 1;
+    }
+
+    Fixture* fixture;
+    try {
+        fixture = new Fixture( nesFile );
+    }
+    catch ( std::exception& e ) {
+        std::cerr << nesFile << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // keep the results alive
+    uint64_t check = 0;
+    // busy first, for the processor to reach its clock before the first
+    // kernel
+    for ( double start = now(); now() - start < 0.3; ) {
+        check += busReadRom( *fixture, 1 << 16 );
+    }
+    int regressions = 0;
+    std::vector<Result> results;
+    printf( "%-24s %10s %10s %10s %8s\n", "", "median", "min", "stddev", "" );
+    for ( size_t i = 0; i < sizeof(Benchmarks) / sizeof(Benchmarks[0]); i++ ) {
+        const Benchmark& b = Benchmarks[i];
+        if ( !supported( b ) || std::string( b.name ).find( filter ) == std::string::npos ) {
+            continue;
+        }
+        Result r = measure( *fixture, b, reps, check );
+        results.push_back( r );
+        printf( "%-24s %10.3f %10.3f %10.3f %-8s", r.name.c_str(), r.median, r.min, r.stddev, r.unit.c_str() );
+        std::map<std::string, double>::const_iterator base = baseline.find( r.name );
+        if ( base != baseline.end() && base->second > 0 ) {
+            double change = (r.min / base->second - 1) * 100;
+            bool slower = change > threshold;
+            printf( " %+7.1f%%%s", change, slower ? "  REGRESSION" : "" );
+            regressions += slower;
+        }
+        printf( "\n" );
+        fflush( stdout );
+    }
+    printf( "decoders: %s, %s (%08x)\n", patternDecoderName(), colorConverterName(), unsigned( check ) );
+
+    if ( !jsonFile.empty() ) {
+        std::ofstream json( jsonFile.c_str() );
+        writeJson( json, results );
+    }
+    delete fixture;
+    if ( regressions ) {
+        printf( "%d regressions over %.0f%%\n", regressions, threshold );
+        return 1;
+    }
+    return 0;
+}
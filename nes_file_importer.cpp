@@ -1,7 +1,59 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
 #include "nes_file_importer.hpp"
 
 std::ostream& operator<<( std::ostream& ostr, const iNESHeader& header )
 {
     ostr << "PRG ROM Size: " << header.PRGRomSize + 0 << std::endl;
     ostr << "CHR ROM Size: " << header.CHRRomSize + 0 << std::endl;
+    ostr << "Mapper: " << header.mapper() << std::endl;
+    return ostr;
+}
+
+NesFile::NesFile( const std::string& path ) : data_( 0 ),
+                                              size_( 0 ),
+                                              prgOffset_( sizeof(iNESHeader) )
+{
+    int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        throw std::runtime_error( "cannot open " + path );
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || size_t( st.st_size ) < sizeof(iNESHeader) ) {
+        close( fd );
+        throw std::runtime_error( "cannot read " + path );
+    }
+    size_ = st.st_size;
+    // private and read-only: a stray write faults instead of changing the file
+    void* mem = mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+    // the mapping keeps the file alive
+    close( fd );
+    if ( mem == MAP_FAILED ) {
+        throw std::runtime_error( "cannot map " + path );
+    }
+    data_ = (uint8_t*)mem;
+
+    if ( memcmp( header().constant, "NES\x1a", 4 ) != 0 ) {
+        munmap( data_, size_ );
+        throw std::runtime_error( path + " is not an iNES file" );
+    }
+    if ( header().flags6 & 4 ) {
+        // trainer
+        prgOffset_ += 512;
+    }
+    if ( prgSize() == 0 || prgOffset_ + prgSize() + chrSize() > size_ ) {
+        munmap( data_, size_ );
+        throw std::runtime_error( "cannot read " + path );
+    }
+}
+
+NesFile::~NesFile()
+{
+    munmap( data_, size_ );
 }
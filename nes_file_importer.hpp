@@ -1,5 +1,10 @@
+#ifndef NES_FILE_IMPORTER_HPP
+#define NES_FILE_IMPORTER_HPP
+
 #include <stdint.h>
+#include <stddef.h>
 #include <ostream>
+#include <string>
 
 //      Header (16 bytes)
 //     Trainer, if present (0 or 512 bytes)
@@ -33,6 +38,48 @@ struct iNESHeader
     uint8_t flags9;
     uint8_t flags10;
     uint8_t padding[5];
+
+    // mapper number, low nibble in flags 6, high nibble in flags 7
+    int mapper() const { return (flags6 >> 4) | (flags7 & 0xF0); }
 };
 
 std::ostream& operator<<( std::ostream&, const iNESHeader& );
+
+///
+/// iNES file mapped in memory, read-only
+///
+/// The PRG and CHR ROMs are used in place by the mapper: the pages of the
+/// file are shared with the page cache (and with the other consoles
+/// running the same file), nothing is copied.
+class NesFile
+{
+public:
+    /// Throws std::runtime_error if the file cannot be mapped, is not an
+    /// iNES file or is shorter than its header says
+    NesFile( const std::string& path );
+    ~NesFile();
+
+    const iNESHeader& header() const { return *(const iNESHeader*)data_; }
+
+    // whole file
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // ROMs, writable pointers for the bus but the pages are read-only
+    uint8_t* prg() const { return data_ + prgOffset_; }
+    size_t prgSize() const { return 16384 * header().PRGRomSize; }
+    // 0 bytes when the board has CHR RAM
+    uint8_t* chr() const { return prg() + prgSize(); }
+    size_t chrSize() const { return 8192 * header().CHRRomSize; }
+
+private:
+    NesFile( const NesFile& );
+    NesFile& operator=( const NesFile& );
+
+    uint8_t* data_;
+    size_t size_;
+    // after the header and the trainer
+    size_t prgOffset_;
+};
+
+#endif
@@ -0,0 +1,346 @@
+// Conformance of the CPU against the log of nestest
+//
+// Usage: nes_nestest [--interpreter] [nes_file log_file]
+//
+// Runs the automated mode of nestest (from $C000, without window) one
+// instruction at a time and checks the registers, the PPU tick and the
+// scanline before each one against the log (data/nestest.nes and
+// data/nestest.log by default). The log is mapped and read in place.
+// Stops on the first difference, with the fields that differ and the
+// instruction that led there. Exits 0 when the whole log matches.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "console.hpp"
+#include "frontend.hpp"
+
+namespace
+{
+
+double now()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+/// Read-only mapping of a whole file
+class MappedFile
+{
+public:
+    /// Throws std::runtime_error if the file cannot be mapped
+    MappedFile( const std::string& path ) : data_( 0 ),
+                                            size_( 0 )
+    {
+        int fd = open( path.c_str(), O_RDONLY );
+        if ( fd < 0 ) {
+            throw std::runtime_error( "cannot open " + path );
+        }
+        struct stat st;
+        if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+            close( fd );
+            throw std::runtime_error( "cannot read " + path );
+        }
+        size_ = st.st_size;
+        void* mem = mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+        close( fd );
+        if ( mem == MAP_FAILED ) {
+            throw std::runtime_error( "cannot map " + path );
+        }
+        data_ = (const char*)mem;
+    }
+    ~MappedFile()
+    {
+        munmap( (void*)data_, size_ );
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile( const MappedFile& );
+    MappedFile& operator=( const MappedFile& );
+
+    const char* data_;
+    size_t size_;
+};
+
+///
+/// State before an instruction, as logged
+///
+/// C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD CYC:  0 SL:241
+struct LogState
+{
+    unsigned int pc, a, x, y, p, sp, cyc, sl;
+};
+
+// columns of the fields
+const int ColumnA = 48;
+const int ColumnX = 53;
+const int ColumnY = 58;
+const int ColumnP = 63;
+const int ColumnSP = 68;
+const int ColumnCYC = 74;
+const int ColumnSL = 82;
+
+// n hexadecimal digits at p, false if one is not
+bool parseHex( const char* p, int n, unsigned int& v )
+{
+    v = 0;
+    for ( int i = 0; i < n; i++ ) {
+        char c = p[i];
+        int d;
+        if ( c >= '0' && c <= '9' ) {
+            d = c - '0';
+        }
+        else if ( (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ) {
+            d = (c | 0x20) - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+        v = (v << 4) | d;
+    }
+    return true;
+}
+
+// decimal number in [p, end), after spaces
+bool parseDec( const char* p, const char* end, unsigned int& v )
+{
+    while ( p < end && *p == ' ' ) {
+        p++;
+    }
+    if ( p == end || *p < '0' || *p > '9' ) {
+        return false;
+    }
+    v = 0;
+    while ( p < end && *p >= '0' && *p <= '9' ) {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    return true;
+}
+
+// tag at column of line (between line and end), then the field
+bool parseField( const char* line, const char* end, int column, const char* tag, int n, unsigned int& v )
+{
+    size_t len = strlen( tag );
+    if ( line + column + len + n > end || memcmp( line + column, tag, len ) != 0 ) {
+        return false;
+    }
+    return parseHex( line + column + len, n, v );
+}
+
+// scanline, -1 for the pre-render line (261)
+bool parseScanline( const char* p, const char* end, unsigned int& v )
+{
+    if ( p < end && *p == '-' ) {
+        if ( !parseDec( p + 1, end, v ) || v > 1 ) {
+            return false;
+        }
+        v = 262 - v;
+        return true;
+    }
+    return parseDec( p, end, v );
+}
+
+bool parseLine( const char* line, const char* end, LogState& s )
+{
+    return parseHex( line, 4, s.pc ) &&
+        parseField( line, end, ColumnA, "A:", 2, s.a ) &&
+        parseField( line, end, ColumnX, "X:", 2, s.x ) &&
+        parseField( line, end, ColumnY, "Y:", 2, s.y ) &&
+        parseField( line, end, ColumnP, "P:", 2, s.p ) &&
+        parseField( line, end, ColumnSP, "SP:", 2, s.sp ) &&
+        line + ColumnCYC + 7 <= end && memcmp( line + ColumnCYC, "CYC:", 4 ) == 0 &&
+        parseDec( line + ColumnCYC + 4, line + ColumnCYC + 7, s.cyc ) &&
+        line + ColumnSL + 3 <= end && memcmp( line + ColumnSL, "SL:", 3 ) == 0 &&
+        parseScanline( line + ColumnSL + 3, end, s.sl );
+}
+
+LogState currentState( const CPU& cpu, const PPU& ppu, int scanlineOffset )
+{
+    LogState s;
+    s.pc = cpu.pc;
+    s.a = cpu.regA;
+    s.x = cpu.regX;
+    s.y = cpu.regY;
+    s.p = cpu.status;
+    s.sp = cpu.sp;
+    s.cyc = ppu.ticks();
+    s.sl = (ppu.scanline() + scanlineOffset) % 262;
+    return s;
+}
+
+void printState( const char* title, const LogState& s )
+{
+    printf( "%-9s %04X  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%3u SL:%u\n", title,
+            s.pc, s.a, s.x, s.y, s.p, s.sp, s.cyc, s.sl );
+}
+
+void printDiff( const char* field, unsigned int expected, unsigned int got, bool hex )
+{
+    if ( expected != got ) {
+        printf( hex ? "  %-3s expected %02X, got %02X\n" : "  %-3s expected %u, got %u\n",
+                field, expected, got );
+    }
+}
+
+// processor status flags, NV..DIZC
+std::string flags( unsigned int p )
+{
+    const char* names = "NV-BDIZC";
+    std::string s;
+    for ( int i = 0; i < 8; i++ ) {
+        s += (p & (0x80 >> i)) ? names[i] : '.';
+    }
+    return s;
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    bool interpreter = false;
+    std::string nesFilePath( "data/nestest.nes" );
+    std::string logFilePath( "data/nestest.log" );
+    int nPaths = 0;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--interpreter" ) {
+            interpreter = true;
+        }
+        else if ( arg[0] != '-' && nPaths < 2 ) {
+            (nPaths++ == 0 ? nesFilePath : logFilePath) = arg;
+        }
+        else {
+            std::cerr << "Arguments: [--interpreter] [nes_file log_file]" << std::endl;
+            return 1;
+        }
+    }
+
+    NullFrontend frontend;
+    Console console( &frontend );
+    MappedFile* log;
+    try {
+        console.load( nesFilePath );
+        log = new MappedFile( logFilePath );
+    }
+    catch ( std::exception& e ) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    CPU& cpu = console.cpu();
+    PPU& ppu = console.ppu();
+    // the automated mode starts at $C000
+    cpu.pc = 0xC000;
+
+    // the log starts in vblank, the PPU at the top of the frame: the
+    // scanlines are compared relative to the first line
+    int scanlineOffset = -1;
+
+    double start = now();
+    const char* p = log->data();
+    const char* end = p + log->size();
+    const char* previous = 0;
+    int previousLength = 0;
+    int n = 0;
+    int status = 0;
+    while ( p < end ) {
+        const char* eol = (const char*)memchr( p, '\n', end - p );
+        if ( !eol ) {
+            eol = end;
+        }
+        const char* line = p;
+        int length = eol - p;
+        if ( length && line[length - 1] == '\r' ) {
+            length--;
+        }
+        p = eol + 1;
+        if ( length == 0 ) {
+            continue;
+        }
+        n++;
+
+        LogState expected;
+        if ( !parseLine( line, line + length, expected ) ) {
+            printf( "%s:%d: cannot parse\n%.*s\n", logFilePath.c_str(), n, length, line );
+            status = 1;
+            break;
+        }
+
+        if ( cpu.irqPending() ) {
+            cpu.cycles = 0;
+            cpu.triggerIRQ();
+            cpu.cycleCount += cpu.cycles;
+        }
+        ppu.sync();
+        if ( scanlineOffset < 0 ) {
+            scanlineOffset = (expected.sl + 262 - ppu.scanline()) % 262;
+        }
+        LogState got = currentState( cpu, ppu, scanlineOffset );
+        if ( memcmp( &expected, &got, sizeof(got) ) != 0 ) {
+            printf( "%s:%d: state differs\n", logFilePath.c_str(), n );
+            if ( previous ) {
+                printf( "after     %.*s\n", previousLength, previous );
+            }
+            printf( "log       %.*s\n", length, line );
+            printState( "expected", expected );
+            printState( "got", got );
+            printDiff( "PC", expected.pc, got.pc, true );
+            printDiff( "A", expected.a, got.a, true );
+            printDiff( "X", expected.x, got.x, true );
+            printDiff( "Y", expected.y, got.y, true );
+            if ( expected.p != got.p ) {
+                printf( "  P   expected %02X %s, got %02X %s\n", expected.p, flags( expected.p ).c_str(),
+                        got.p, flags( got.p ).c_str() );
+            }
+            printDiff( "SP", expected.sp, got.sp, true );
+            printDiff( "CYC", expected.cyc, got.cyc, false );
+            printDiff( "SL", expected.sl, got.sl, false );
+            status = 1;
+            break;
+        }
+
+        uint16_t pc = cpu.pc;
+        Instruction instr = cpu.decode( pc );
+        cpu.cycles = 0;
+        cpu.pc += instr.nOperands + 1;
+        if ( interpreter ) {
+            cpu.execute<ReleasePolicy>( instr );
+        }
+        else {
+            cpu.dispatch<ReleasePolicy>( instr );
+        }
+        cpu.cycleCount += cpu.cycles;
+        if ( cpu.stopped() ) {
+            cpu.locateFault( pc );
+            std::ostringstream fault;
+            fault << cpu.fault();
+            printf( "%s:%d: %s\n%.*s\n", logFilePath.c_str(), n, fault.str().c_str(), length, line );
+            status = 1;
+            break;
+        }
+        previous = line;
+        previousLength = length;
+    }
+    double elapsed = now() - start;
+    delete log;
+
+    if ( status == 0 ) {
+        printf( "%d lines OK in %.2f ms\n", n, elapsed * 1000 );
+    }
+    return status;
+}
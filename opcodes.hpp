@@ -0,0 +1,268 @@
+#ifndef NES_OPCODES_HPP
+#define NES_OPCODES_HPP
+
+///
+/// The 256 opcodes of the 6502, as an X-macro:
+/// OP( opcode, mnemonic, addressing, number of base cycles )
+///
+/// Used to fill InstructionDefinition::table() and to instantiate the
+/// specialized handlers of the threaded dispatch, so both stay in sync.
+#define NES_OPCODES( OP ) \
+    OP(0x00, MNEMONIC_BRK, ADDRESSING_NONE, 7) \
+    OP(0x01, MNEMONIC_ORA, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x02, MNEMONIC_ASL, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x03, MNEMONIC_SLO, ADDRESSING_INDIRECT_X, 8) \
+    OP(0x04, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x05, MNEMONIC_ORA, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x06, MNEMONIC_ASL, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x07, MNEMONIC_SLO, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x08, MNEMONIC_PHP, ADDRESSING_NONE, 3) \
+    OP(0x09, MNEMONIC_ORA, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x0a, MNEMONIC_ASL, ADDRESSING_ACCUMULATOR, 2) \
+    OP(0x0b, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0x0c, MNEMONIC_NOP, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x0d, MNEMONIC_ORA, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x0e, MNEMONIC_ASL, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x0f, MNEMONIC_SLO, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x10, MNEMONIC_BPL, ADDRESSING_RELATIVE, 2) \
+    OP(0x11, MNEMONIC_ORA, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0x12, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x13, MNEMONIC_SLO, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0x14, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x15, MNEMONIC_ORA, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x16, MNEMONIC_ASL, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x17, MNEMONIC_SLO, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x18, MNEMONIC_CLC, ADDRESSING_NONE, 2) \
+    OP(0x19, MNEMONIC_ORA, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0x1a, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x1b, MNEMONIC_SLO, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0x1c, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x1d, MNEMONIC_ORA, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x1e, MNEMONIC_ASL, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x1f, MNEMONIC_SLO, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x20, MNEMONIC_JSR, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x21, MNEMONIC_AND, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x22, MNEMONIC_ROL, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x23, MNEMONIC_RLA, ADDRESSING_INDIRECT_X, 8) \
+    OP(0x24, MNEMONIC_BIT, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x25, MNEMONIC_AND, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x26, MNEMONIC_ROL, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x27, MNEMONIC_RLA, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x28, MNEMONIC_PLP, ADDRESSING_NONE, 4) \
+    OP(0x29, MNEMONIC_AND, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x2a, MNEMONIC_ROL, ADDRESSING_ACCUMULATOR, 2) \
+    OP(0x2b, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0x2c, MNEMONIC_BIT, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x2d, MNEMONIC_AND, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x2e, MNEMONIC_ROL, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x2f, MNEMONIC_RLA, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x30, MNEMONIC_BMI, ADDRESSING_RELATIVE, 2) \
+    OP(0x31, MNEMONIC_AND, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0x32, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x33, MNEMONIC_RLA, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0x34, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x35, MNEMONIC_AND, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x36, MNEMONIC_ROL, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x37, MNEMONIC_RLA, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x38, MNEMONIC_SEC, ADDRESSING_NONE, 2) \
+    OP(0x39, MNEMONIC_AND, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0x3a, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x3b, MNEMONIC_RLA, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0x3c, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x3d, MNEMONIC_AND, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x3e, MNEMONIC_ROL, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x3f, MNEMONIC_RLA, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x40, MNEMONIC_RTI, ADDRESSING_NONE, 6) \
+    OP(0x41, MNEMONIC_EOR, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x42, MNEMONIC_LSR, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x43, MNEMONIC_SRE, ADDRESSING_INDIRECT_X, 8) \
+    OP(0x44, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x45, MNEMONIC_EOR, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x46, MNEMONIC_LSR, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x47, MNEMONIC_SRE, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x48, MNEMONIC_PHA, ADDRESSING_NONE, 3) \
+    OP(0x49, MNEMONIC_EOR, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x4a, MNEMONIC_LSR, ADDRESSING_ACCUMULATOR, 2) \
+    OP(0x4b, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0x4c, MNEMONIC_JMP, ADDRESSING_ABSOLUTE, 3) \
+    OP(0x4d, MNEMONIC_EOR, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x4e, MNEMONIC_LSR, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x4f, MNEMONIC_SRE, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x50, MNEMONIC_BVC, ADDRESSING_RELATIVE, 2) \
+    OP(0x51, MNEMONIC_EOR, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0x52, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x53, MNEMONIC_SRE, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0x54, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x55, MNEMONIC_EOR, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x56, MNEMONIC_LSR, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x57, MNEMONIC_SRE, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x58, MNEMONIC_CLI, ADDRESSING_NONE, 2) \
+    OP(0x59, MNEMONIC_EOR, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0x5a, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x5b, MNEMONIC_SRE, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0x5c, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x5d, MNEMONIC_EOR, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x5e, MNEMONIC_LSR, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x5f, MNEMONIC_SRE, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x60, MNEMONIC_RTS, ADDRESSING_NONE, 6) \
+    OP(0x61, MNEMONIC_ADC, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x62, MNEMONIC_ROR, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x63, MNEMONIC_RRA, ADDRESSING_INDIRECT_X, 8) \
+    OP(0x64, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x65, MNEMONIC_ADC, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x66, MNEMONIC_ROR, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x67, MNEMONIC_RRA, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0x68, MNEMONIC_PLA, ADDRESSING_NONE, 4) \
+    OP(0x69, MNEMONIC_ADC, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x6a, MNEMONIC_ROR, ADDRESSING_ACCUMULATOR, 2) \
+    OP(0x6b, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0x6c, MNEMONIC_JMP, ADDRESSING_INDIRECT, 5) \
+    OP(0x6d, MNEMONIC_ADC, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x6e, MNEMONIC_ROR, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x6f, MNEMONIC_RRA, ADDRESSING_ABSOLUTE, 6) \
+    OP(0x70, MNEMONIC_BVS, ADDRESSING_RELATIVE, 2) \
+    OP(0x71, MNEMONIC_ADC, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0x72, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x73, MNEMONIC_RRA, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0x74, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x75, MNEMONIC_ADC, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x76, MNEMONIC_ROR, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x77, MNEMONIC_RRA, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0x78, MNEMONIC_SEI, ADDRESSING_NONE, 2) \
+    OP(0x79, MNEMONIC_ADC, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0x7a, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x7b, MNEMONIC_RRA, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0x7c, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x7d, MNEMONIC_ADC, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0x7e, MNEMONIC_ROR, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x7f, MNEMONIC_RRA, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0x80, MNEMONIC_NOP, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x81, MNEMONIC_STA, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x82, MNEMONIC_STX, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x83, MNEMONIC_SAX, ADDRESSING_INDIRECT_X, 6) \
+    OP(0x84, MNEMONIC_STY, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x85, MNEMONIC_STA, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x86, MNEMONIC_STX, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x87, MNEMONIC_SAX, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0x88, MNEMONIC_DEY, ADDRESSING_NONE, 2) \
+    OP(0x89, MNEMONIC_STA, ADDRESSING_IMMEDIATE, 2) \
+    OP(0x8a, MNEMONIC_TXA, ADDRESSING_NONE, 2) \
+    OP(0x8b, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0x8c, MNEMONIC_STY, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x8d, MNEMONIC_STA, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x8e, MNEMONIC_STX, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x8f, MNEMONIC_SAX, ADDRESSING_ABSOLUTE, 4) \
+    OP(0x90, MNEMONIC_BCC, ADDRESSING_RELATIVE, 2) \
+    OP(0x91, MNEMONIC_STA, ADDRESSING_INDIRECT_Y, 6) \
+    OP(0x92, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0x93, MNEMONIC_ILL, ADDRESSING_NONE, 6) \
+    OP(0x94, MNEMONIC_STY, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x95, MNEMONIC_STA, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0x96, MNEMONIC_STX, ADDRESSING_ZERO_PAGE_Y, 4) \
+    OP(0x97, MNEMONIC_SAX, ADDRESSING_ZERO_PAGE_Y, 4) \
+    OP(0x98, MNEMONIC_TYA, ADDRESSING_NONE, 2) \
+    OP(0x99, MNEMONIC_STA, ADDRESSING_ABSOLUTE_Y, 5) \
+    OP(0x9a, MNEMONIC_TXS, ADDRESSING_NONE, 2) \
+    OP(0x9b, MNEMONIC_ILL, ADDRESSING_NONE, 5) \
+    OP(0x9c, MNEMONIC_STY, ADDRESSING_ABSOLUTE_X, 5) \
+    OP(0x9d, MNEMONIC_STA, ADDRESSING_ABSOLUTE_X, 5) \
+    OP(0x9e, MNEMONIC_STX, ADDRESSING_ABSOLUTE_Y, 5) \
+    OP(0x9f, MNEMONIC_ILL, ADDRESSING_NONE, 5) \
+    OP(0xa0, MNEMONIC_LDY, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xa1, MNEMONIC_LDA, ADDRESSING_INDIRECT_X, 6) \
+    OP(0xa2, MNEMONIC_LDX, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xa3, MNEMONIC_LAX, ADDRESSING_INDIRECT_X, 6) \
+    OP(0xa4, MNEMONIC_LDY, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xa5, MNEMONIC_LDA, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xa6, MNEMONIC_LDX, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xa7, MNEMONIC_LAX, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xa8, MNEMONIC_TAY, ADDRESSING_NONE, 2) \
+    OP(0xa9, MNEMONIC_LDA, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xaa, MNEMONIC_TAX, ADDRESSING_NONE, 2) \
+    OP(0xab, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0xac, MNEMONIC_LDY, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xad, MNEMONIC_LDA, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xae, MNEMONIC_LDX, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xaf, MNEMONIC_LAX, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xb0, MNEMONIC_BCS, ADDRESSING_RELATIVE, 2) \
+    OP(0xb1, MNEMONIC_LDA, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0xb2, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xb3, MNEMONIC_LAX, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0xb4, MNEMONIC_LDY, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xb5, MNEMONIC_LDA, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xb6, MNEMONIC_LDX, ADDRESSING_ZERO_PAGE_Y, 4) \
+    OP(0xb7, MNEMONIC_LAX, ADDRESSING_ZERO_PAGE_Y, 4) \
+    OP(0xb8, MNEMONIC_CLV, ADDRESSING_NONE, 2) \
+    OP(0xb9, MNEMONIC_LDA, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0xba, MNEMONIC_TSX, ADDRESSING_NONE, 2) \
+    OP(0xbb, MNEMONIC_ILL, ADDRESSING_NONE, 4) \
+    OP(0xbc, MNEMONIC_LDY, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xbd, MNEMONIC_LDA, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xbe, MNEMONIC_LDX, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0xbf, MNEMONIC_LAX, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0xc0, MNEMONIC_CPY, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xc1, MNEMONIC_CMP, ADDRESSING_INDIRECT_X, 6) \
+    OP(0xc2, MNEMONIC_DEC, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xc3, MNEMONIC_DCP, ADDRESSING_INDIRECT_X, 8) \
+    OP(0xc4, MNEMONIC_CPY, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xc5, MNEMONIC_CMP, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xc6, MNEMONIC_DEC, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0xc7, MNEMONIC_DCP, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0xc8, MNEMONIC_INY, ADDRESSING_NONE, 2) \
+    OP(0xc9, MNEMONIC_CMP, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xca, MNEMONIC_DEX, ADDRESSING_NONE, 2) \
+    OP(0xcb, MNEMONIC_ILL, ADDRESSING_NONE, 2) \
+    OP(0xcc, MNEMONIC_CPY, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xcd, MNEMONIC_CMP, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xce, MNEMONIC_DEC, ADDRESSING_ABSOLUTE, 6) \
+    OP(0xcf, MNEMONIC_DCP, ADDRESSING_ABSOLUTE, 6) \
+    OP(0xd0, MNEMONIC_BNE, ADDRESSING_RELATIVE, 2) \
+    OP(0xd1, MNEMONIC_CMP, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0xd2, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xd3, MNEMONIC_DCP, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0xd4, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xd5, MNEMONIC_CMP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xd6, MNEMONIC_DEC, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0xd7, MNEMONIC_DCP, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0xd8, MNEMONIC_CLD, ADDRESSING_NONE, 2) \
+    OP(0xd9, MNEMONIC_CMP, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0xda, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xdb, MNEMONIC_DCP, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0xdc, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xdd, MNEMONIC_CMP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xde, MNEMONIC_DEC, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0xdf, MNEMONIC_DCP, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0xe0, MNEMONIC_CPX, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xe1, MNEMONIC_SBC, ADDRESSING_INDIRECT_X, 6) \
+    OP(0xe2, MNEMONIC_INC, ADDRESSING_IMMEDIATE, 3) \
+    OP(0xe3, MNEMONIC_ISC, ADDRESSING_INDIRECT_X, 8) \
+    OP(0xe4, MNEMONIC_CPX, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xe5, MNEMONIC_SBC, ADDRESSING_ZERO_PAGE, 3) \
+    OP(0xe6, MNEMONIC_INC, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0xe7, MNEMONIC_ISC, ADDRESSING_ZERO_PAGE, 5) \
+    OP(0xe8, MNEMONIC_INX, ADDRESSING_NONE, 2) \
+    OP(0xe9, MNEMONIC_SBC, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xea, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xeb, MNEMONIC_SBC, ADDRESSING_IMMEDIATE, 2) \
+    OP(0xec, MNEMONIC_CPX, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xed, MNEMONIC_SBC, ADDRESSING_ABSOLUTE, 4) \
+    OP(0xee, MNEMONIC_INC, ADDRESSING_ABSOLUTE, 6) \
+    OP(0xef, MNEMONIC_ISC, ADDRESSING_ABSOLUTE, 6) \
+    OP(0xf0, MNEMONIC_BEQ, ADDRESSING_RELATIVE, 2) \
+    OP(0xf1, MNEMONIC_SBC, ADDRESSING_INDIRECT_Y, 5) \
+    OP(0xf2, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xf3, MNEMONIC_ISC, ADDRESSING_INDIRECT_Y, 8) \
+    OP(0xf4, MNEMONIC_NOP, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xf5, MNEMONIC_SBC, ADDRESSING_ZERO_PAGE_X, 4) \
+    OP(0xf6, MNEMONIC_INC, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0xf7, MNEMONIC_ISC, ADDRESSING_ZERO_PAGE_X, 6) \
+    OP(0xf8, MNEMONIC_SED, ADDRESSING_NONE, 2) \
+    OP(0xf9, MNEMONIC_SBC, ADDRESSING_ABSOLUTE_Y, 4) \
+    OP(0xfa, MNEMONIC_NOP, ADDRESSING_NONE, 2) \
+    OP(0xfb, MNEMONIC_ISC, ADDRESSING_ABSOLUTE_Y, 7) \
+    OP(0xfc, MNEMONIC_NOP, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xfd, MNEMONIC_SBC, ADDRESSING_ABSOLUTE_X, 4) \
+    OP(0xfe, MNEMONIC_INC, ADDRESSING_ABSOLUTE_X, 7) \
+    OP(0xff, MNEMONIC_ISC, ADDRESSING_ABSOLUTE_X, 7)
+
+#endif
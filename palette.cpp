@@ -0,0 +1,155 @@
+#include "palette.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+const uint8_t NesPalette[64][3] = {
+    0x7C,0x7C,0x7C,
+    0x00,0x00,0xFC,
+    0x00,0x00,0xBC,
+    0x44,0x28,0xBC,
+    0x94,0x00,0x84,
+    0xA8,0x00,0x20,
+    0xA8,0x10,0x00,
+    0x88,0x14,0x00,
+    0x50,0x30,0x00,
+    0x00,0x78,0x00,
+    0x00,0x68,0x00,
+    0x00,0x58,0x00,
+    0x00,0x40,0x58,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00,
+    0xBC,0xBC,0xBC,
+    0x00,0x78,0xF8,
+    0x00,0x58,0xF8,
+    0x68,0x44,0xFC,
+    0xD8,0x00,0xCC,
+    0xE4,0x00,0x58,
+    0xF8,0x38,0x00,
+    0xE4,0x5C,0x10,
+    0xAC,0x7C,0x00,
+    0x00,0xB8,0x00,
+    0x00,0xA8,0x00,
+    0x00,0xA8,0x44,
+    0x00,0x88,0x88,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00,
+    0xF8,0xF8,0xF8,
+    0x3C,0xBC,0xFC,
+    0x68,0x88,0xFC,
+    0x98,0x78,0xF8,
+    0xF8,0x78,0xF8,
+    0xF8,0x58,0x98,
+    0xF8,0x78,0x58,
+    0xFC,0xA0,0x44,
+    0xF8,0xB8,0x00,
+    0xB8,0xF8,0x18,
+    0x58,0xD8,0x54,
+    0x58,0xF8,0x98,
+    0x00,0xE8,0xD8,
+    0x78,0x78,0x78,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00,
+    0xFC,0xFC,0xFC,
+    0xA4,0xE4,0xFC,
+    0xB8,0xB8,0xF8,
+    0xD8,0xB8,0xF8,
+    0xF8,0xB8,0xF8,
+    0xF8,0xA4,0xC0,
+    0xF0,0xD0,0xB0,
+    0xFC,0xE0,0xA8,
+    0xF8,0xD8,0x78,
+    0xD8,0xF8,0x78,
+    0xB8,0xF8,0xB8,
+    0xB8,0xF8,0xD8,
+    0x00,0xFC,0xFC,
+    0xF8,0xD8,0xF8,
+    0x00,0x00,0x00,
+    0x00,0x00,0x00
+};
+
+void buildColorTable( uint8_t mask, uint32_t* table )
+{
+    // emphasized channels keep their intensity, the others are darkened
+    // (R: bit 5, G: bit 6, B: bit 7)
+    uint8_t emphasis = mask >> 5;
+    for ( int i = 0; i < 64; i++ ) {
+        // grayscale keeps the column 0 of the palette
+        int c = (mask & 1) ? (i & 0x30) : i;
+        uint32_t rgb = 0;
+        for ( int k = 0; k < 3; k++ ) {
+            uint32_t v = NesPalette[c][k];
+            // the columns $E and $F are black and not affected
+            if ( emphasis && !(emphasis & (1 << k)) && ((c & 0x0E) != 0x0E) ) {
+                v = v * 3 / 4;
+            }
+            rgb = (rgb << 8) | v;
+        }
+        table[i] = rgb;
+    }
+}
+
+void convertToXRGBScalar( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out )
+{
+    for ( size_t i = 0; i < n; i++ ) {
+        out[i] = table[in[i] & 63];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("avx2")))
+void convertToXRGBAVX2( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out )
+{
+    const __m256i mask = _mm256_set1_epi32( 63 );
+    size_t i = 0;
+    // 8 pixels at a time: indices widened to 32 bits, then gathered
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m256i idx = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(in + i) ) );
+        idx = _mm256_and_si256( idx, mask );
+        __m256i c = _mm256_i32gather_epi32( (const int*)table, idx, 4 );
+        _mm256_storeu_si256( (__m256i*)(out + i), c );
+    }
+    convertToXRGBScalar( in + i, n - i, table, out + i );
+}
+
+#endif
+
+namespace
+{
+
+struct Selected
+{
+    ColorConverter converter;
+    const char* name;
+    Selected()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) ) {
+            converter = convertToXRGBAVX2;
+            name = "avx2";
+            return;
+        }
+#endif
+        converter = convertToXRGBScalar;
+        name = "scalar";
+    }
+};
+
+}
+
+static const Selected selected;
+
+void convertToXRGB( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out )
+{
+    selected.converter( in, n, table, out );
+}
+
+const char* colorConverterName()
+{
+    return selected.name;
+}
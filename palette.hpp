@@ -0,0 +1,32 @@
+#ifndef NES_PALETTE_HPP
+#define NES_PALETTE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+///
+/// Conversion of palette indices to host colors
+///
+
+/// RGB components of the 64 colors of the NES
+extern const uint8_t NesPalette[64][3];
+
+/// Fill the 64 XRGB8888 colors seen for the given value of the PPU Mask
+/// register: grayscale (bit 0) and color emphasis (bits 5 to 7)
+void buildColorTable( uint8_t mask, uint32_t* table );
+
+/// Convert n palette indices (6 low bits) to XRGB8888 colors through table
+/// Uses AVX2 when available.
+void convertToXRGB( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out );
+
+/// Implementations of convertToXRGB, for tests and benchmarks
+typedef void (*ColorConverter)( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out );
+void convertToXRGBScalar( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out );
+#if defined(__x86_64__) || defined(__i386__)
+void convertToXRGBAVX2( const uint8_t* in, size_t n, const uint32_t* table, uint32_t* out );
+#endif
+
+/// name of the implementation used by convertToXRGB
+const char* colorConverterName();
+
+#endif
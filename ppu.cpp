@@ -1,8 +1,13 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include "ppu.hpp"
 #include "cpu.hpp"
+#include "tile_decoder.hpp"
+#include "frontend.hpp"
+#include "mapper.hpp"
+#include "trace.hpp"
 
 std::ostream& operator<<( std::ostream& ostr, const PPU::Address& adr )
 {
@@ -24,105 +29,71 @@ std::ostream& operator<<( std::ostream& ostr, const PPU::Controller& adr )
     adr.print(ostr);
     return ostr;
 }
-const int NesPalette[][3] = {
-    0x7C,0x7C,0x7C,
-    0x00,0x00,0xFC,
-    0x00,0x00,0xBC,
-    0x44,0x28,0xBC,
-    0x94,0x00,0x84,
-    0xA8,0x00,0x20,
-    0xA8,0x10,0x00,
-    0x88,0x14,0x00,
-    0x50,0x30,0x00,
-    0x00,0x78,0x00,
-    0x00,0x68,0x00,
-    0x00,0x58,0x00,
-    0x00,0x40,0x58,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00,
-    0xBC,0xBC,0xBC,
-    0x00,0x78,0xF8,
-    0x00,0x58,0xF8,
-    0x68,0x44,0xFC,
-    0xD8,0x00,0xCC,
-    0xE4,0x00,0x58,
-    0xF8,0x38,0x00,
-    0xE4,0x5C,0x10,
-    0xAC,0x7C,0x00,
-    0x00,0xB8,0x00,
-    0x00,0xA8,0x00,
-    0x00,0xA8,0x44,
-    0x00,0x88,0x88,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00,
-    0xF8,0xF8,0xF8,
-    0x3C,0xBC,0xFC,
-    0x68,0x88,0xFC,
-    0x98,0x78,0xF8,
-    0xF8,0x78,0xF8,
-    0xF8,0x58,0x98,
-    0xF8,0x78,0x58,
-    0xFC,0xA0,0x44,
-    0xF8,0xB8,0x00,
-    0xB8,0xF8,0x18,
-    0x58,0xD8,0x54,
-    0x58,0xF8,0x98,
-    0x00,0xE8,0xD8,
-    0x78,0x78,0x78,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00,
-    0xFC,0xFC,0xFC,
-    0xA4,0xE4,0xFC,
-    0xB8,0xB8,0xF8,
-    0xD8,0xB8,0xF8,
-    0xF8,0xB8,0xF8,
-    0xF8,0xA4,0xC0,
-    0xF0,0xD0,0xB0,
-    0xFC,0xE0,0xA8,
-    0xF8,0xD8,0x78,
-    0xD8,0xF8,0x78,
-    0xB8,0xF8,0xB8,
-    0xB8,0xF8,0xD8,
-    0x00,0xFC,0xFC,
-    0xF8,0xD8,0xF8,
-    0x00,0x00,0x00,
-    0x00,0x00,0x00
-};
-
-PPU::PPU( CPU* cpu ) : mem_( 0x4000 ),
-                       screen_( 240*256 ),
-                       tick_(0),
-                       scanline_(0),
-                       ppuaddr( 0 ),
-                       ppuaddr_t( 0 ),
-                       cpu_( cpu ),
-                       oam_addr_( 0 ),
-                       write_low_addr_( 0 ),
-                       n_next_sprites_( 0 ),
-                       nametable_( 240*256 ),
-                       screen_tex_( 0 )
+
+PPU::PPU( CPU* cpu, Frontend* frontend ) : frontend_( frontend ),
+                                           mem_( 0x4000 ),
+                                           screen_( 240*256 ),
+                                           lineCounter_( 0 ),
+                                           tick_(0),
+                                           scanline_(0),
+                                           time_(0),
+                                           nextEvent_(0),
+                                           frames_(0),
+                                           renderMode_( RenderScanline ),
+                                           video_( true ),
+                                           ppuaddr( 0 ),
+                                           ppuaddr_t( 0 ),
+                                           fine_x_( 0 ),
+                                           cpu_( cpu ),
+                                           oam_addr_( 0 ),
+                                           write_low_addr_( 0 ),
+                                           bg_pos_( 0 ),
+                                           n_next_sprites_( 0 ),
+                                           nametable_( 240*256 )
 {
-    win_ = SDL_CreateWindow( "Test", 0, 0, 512, 480, 0 );
-    if ( ! win_ ) {
-        throw std::runtime_error( "create window" );
+    memset( bg_pixels_, 0, sizeof(bg_pixels_) );
+    memset( oam_, 0, sizeof(oam_) );
+    memset( oam2_, 0, sizeof(oam2_) );
+    memset( next_sprites_, 0, sizeof(next_sprites_) );
+    memset( sprite_x_, 0, sizeof(sprite_x_) );
+    for ( int i = 0; i < 8; i++ ) {
+        mapPatterns( i, &mem_[i * 0x400], true );
     }
-    renderer_ = SDL_CreateRenderer( win_, -1, 0 );
-    if ( ! renderer_ ) {
-        throw std::runtime_error( "create renderer" );
+    setMirroring( MirrorFourScreen );
+}
+
+PPU::~PPU()
+{
+}
+
+void PPU::setMirroring( Mirroring mirroring )
+{
+    // banks of the 4 KB at $2000 used by each nametable
+    static const int banks[5][4] = {
+        { 0, 0, 1, 1 },
+        { 0, 1, 0, 1 },
+        { 0, 0, 0, 0 },
+        { 1, 1, 1, 1 },
+        { 0, 1, 2, 3 }
+    };
+    for ( int i = 0; i < 4; i++ ) {
+        nametables_[i] = &mem_[0x2000 + banks[mirroring][i] * 0x400];
     }
+}
 
-    screen_tex_ = SDL_CreateTexture( renderer_,
-                                     SDL_PIXELFORMAT_RGB24,
-                                     SDL_TEXTUREACCESS_STREAMING,
-                                     32*8,
-                                     30*8 );
+void PPU::setMapper( Mapper* mapper )
+{
+    lineCounter_ = mapper && mapper->countsScanlines() ? mapper : 0;
 }
 
-PPU::~PPU()
+void PPU::lineDone()
 {
-    SDL_Quit();
+    // the counter is clocked on the visible and pre-render lines, by the
+    // sprite fetches on real hardware (approximated by the end of line)
+    if ( lineCounter_ && (mask_.bits.show_background || mask_.bits.show_sprites) &&
+         (scanline_ < 240 || scanline_ == 261) ) {
+        lineCounter_->scanline();
+    }
 }
 
 void PPU::print_context()
@@ -180,10 +151,12 @@ void PPU::dump_mem( const std::string& out_file ) const
     std::string pal_file = out_file + ".pal";
     std::string nam_file = out_file + ".nam";
     std::ofstream of_chr( chr_file.c_str() );
-    of_chr.write( (char*)&mem_[pattern], 0x1000 );
+    for ( int i = 0; i < 4; i++ ) {
+        of_chr.write( (const char*)this->pattern( pattern + i * 0x400 ), 0x400 );
+    }
     of_chr.close();
     std::ofstream of_nam( nam_file.c_str() );
-    of_nam.write( (char*)&mem_[nametable], 0x400 );
+    of_nam.write( (const char*)nametables_[(nametable >> 10) & 3], 0x400 );
     of_nam.close();
     std::ofstream of_pal( pal_file.c_str() );
     of_pal.write( (char*)&mem_[0x3F00], 16 );
@@ -192,19 +165,15 @@ void PPU::dump_mem( const std::string& out_file ) const
 
 void PPU::get_pattern( uint16_t baseAddr, int idx, uint8_t* ptr, int row_length, int paletteNum )
 {
-    uint8_t palette0 = mem_[0x3F00];
-    uint8_t *palette = &mem_[0x3F00 + paletteNum * 4];
+    uint8_t palette[4] = { uint8_t( mem_[0x3F00] & 63 ),
+                           uint8_t( mem_[0x3F00 + paletteNum * 4 + 1] & 63 ),
+                           uint8_t( mem_[0x3F00 + paletteNum * 4 + 2] & 63 ),
+                           uint8_t( mem_[0x3F00 + paletteNum * 4 + 3] & 63 ) };
+    uint8_t c[64];
+    decodePattern( pattern( baseAddr + idx*16 ), c );
     for ( int i = 0; i < 8; i++ ) {
-        uint8_t spA = mem_[baseAddr + idx*16+i+0];
-        uint8_t spB = mem_[baseAddr + idx*16+i+8];
-        for ( int j = 7; j >= 0; j-- ) {
-            uint8_t c = ((spA & (1 << j)) >> j) | (((spB & (1 << j)) >> j) << 1);
-            if ( c == 0 ) {
-                *ptr++ = palette0 & 63;
-            }
-            else {
-                *ptr++ = palette[c] & 63;
-            }
+        for ( int j = 0; j < 8; j++ ) {
+            *ptr++ = palette[c[i*8+j]];
         }
         ptr += row_length-8;
     }
@@ -213,14 +182,7 @@ void PPU::get_pattern( uint16_t baseAddr, int idx, uint8_t* ptr, int row_length,
 void PPU::get_sprite( int idx, uint8_t *ptr )
 {
     uint16_t baseAddr = ctrl_.bits.sprite_pattern ? 0x1000 : 0;
-    for ( int i = 0; i < 8; i++ ) {
-        uint8_t spA = mem_[baseAddr + idx*16+i+0];
-        uint8_t spB = mem_[baseAddr + idx*16+i+8];
-        for ( int j = 7; j >= 0; j-- ) {
-            uint8_t c = ((spA & (1 << j)) >> j) | (((spB & (1 << j)) >> j) << 1);
-            *ptr++ = c;
-        }
-    }
+    decodePattern( pattern( baseAddr + idx*16 ), ptr );
 }
 
 void PPU::frame()
@@ -243,15 +205,7 @@ void PPU::frame()
             int x = tick_;
             int y = scanline_;
             if ( (tick_-1) % 8 == 0 ) {
-                // increment x
-                if ( ppuaddr.bits.coarse_x < 31 ) {
-                    ppuaddr.bits.coarse_x ++;
-                }
-                else {
-                    ppuaddr.bits.coarse_x = 0;
-                    // switch nametable 2000 <-> 2400, 2800 <-> 2C00
-                    ppuaddr.bits.nametable ^= 1;
-                }
+                incrementX();
                 int x16 = ppuaddr.bits.coarse_x / 2;
                 int y16 = ppuaddr.bits.coarse_y / 2;
 
@@ -261,21 +215,24 @@ void PPU::frame()
                     ((ppuaddr.bits.coarse_y / 4) << 3) |
                     (ppuaddr.bits.coarse_x / 4);
 
-                uint8_t nametable_byte = mem_[ tile_addr ];
+                uint8_t nametable_byte = nametable( tile_addr );
                 //                pal_shift = mem_[ attr_addr ];
 
                 uint16_t bg_addr = ctrl_.bits.background_pattern ? 0x1000 : 0;
-                bg_shift_l = (bg_shift_l & 0xFF00) | (mem_[ bg_addr + (nametable_byte<<4)+ppuaddr.bits.fine_y+0 ]);
-                bg_shift_h = (bg_shift_h & 0xFF00) | (mem_[ bg_addr + (nametable_byte<<4)+ppuaddr.bits.fine_y+8 ]);
+                uint16_t tile = bg_addr + (nametable_byte<<4) + ppuaddr.bits.fine_y;
+                // the high half is kept, the new tile goes to the low half
+                memmove( &bg_pixels_[0], &bg_pixels_[bg_pos_], 8 );
+                const uint8_t* row = pattern( tile );
+                decodePatternRow( row[0], row[8], &bg_pixels_[8] );
+                bg_pos_ = 0;
             }
 
             // bg color
-            int d = 15-fine_x_;
-            uint8_t c = ((bg_shift_l & (1<<d)) >> d) |
-                (((bg_shift_h & (1<<d)) >> d)<<1);
+            uint8_t c = bg_pixels_[ bg_pos_ + fine_x_ ];
             // shift
-            bg_shift_l <<= 1;
-            bg_shift_h <<= 1;
+            if ( bg_pos_ < 16 ) {
+                bg_pos_++;
+            }
 
             uint8_t pal = 0;
             #if 0
@@ -324,19 +281,7 @@ void PPU::frame()
                         // +-------- Flip sprite vertically
                         
                         uint8_t pal = (att & 3) + 4;
-                        bool h_flip = (att & 0x40);
-                        bool v_flip = (att & 0x80);
-                        uint8_t sp_c;
-                        if ( h_flip ) {
-                            sp_c = (next_sprites_[i][0] & 1) | ( (next_sprites_[i][1] & 1) << 1 );
-                            next_sprites_[i][0] >>= 1;
-                            next_sprites_[i][1] >>= 1;
-                        }
-                        else {
-                            sp_c = ((next_sprites_[i][0] & 0x80) >> 7) | ( ((next_sprites_[i][1] & 0x80) >> 7) << 1 );
-                            next_sprites_[i][0] <<= 1;
-                            next_sprites_[i][1] <<= 1;
-                        }
+                        uint8_t sp_c = next_sprites_[i][ -sprite_x_[i] ];
                         /*if (idx == 0 && sp_c && c )*/ {
                             status_.bits.sprite0_hit = 1;
                         }
@@ -352,55 +297,13 @@ void PPU::frame()
         }
         else if ( tick_ < 321 ) {
             if ( tick_ == 256 ) {
-                // increment Y
-                if ( ppuaddr.bits.fine_y < 7 ) {
-                    ppuaddr.bits.fine_y ++;
-                }
-                else {
-                    ppuaddr.bits.fine_y = 0;
-                    if ( ppuaddr.bits.coarse_y == 29 ) {
-                        ppuaddr.bits.coarse_y = 0;
-                        ppuaddr.bits.nametable ^= 2;
-                    }
-                    else if ( ppuaddr.bits.coarse_y == 31 ) {
-                        ppuaddr.bits.coarse_y = 0;
-                    }
-                    else {
-                        ppuaddr.bits.coarse_y ++;
-                    }
-                }
+                incrementY();
             }
             else if ( tick_ == 257 ) {
-                // copy t to v (horizontal part)
-                //v: ....F.. ...EDCBA = t: ....F.. ...EDCBA
-                ppuaddr.raw = (ppuaddr.raw & 0xFFBE0) | (ppuaddr_t.raw & 0x041F);
+                copyX();
             }
 #if 1
-            // fetch sprites for the next scanline
-            uint16_t baseAddr = ctrl_.bits.sprite_pattern ? 0x1000 : 0;
-            int j = 0;
-            for ( int i = 0; (j < 8) && (i < 64); i++ ) {
-                uint8_t sy   = oam_[ i * 4 + 0 ];
-                uint8_t sx   = oam_[ i * 4 + 3 ];
-                uint8_t idx  = oam_[ i * 4 + 1 ];
-                uint8_t att  = oam_[ i * 4 + 2 ];
-                if ( sy > 0xef ) {
-                    continue;
-                }
-                if ( scanline_ >= sy + 8 || scanline_ < sy ) {
-                    continue;
-                }
-                int dy = scanline_-sy;
-                if (att & 0x80) { // vertical flip
-                    dy = 7 - dy;
-                }
-                memcpy( &oam2_[j*4], &oam_[i*4], 4 );
-                next_sprites_[j][0] = mem_[ baseAddr + (idx*16) + dy + 0 ];
-                next_sprites_[j][1] = mem_[ baseAddr + (idx*16) + dy + 8 ];
-                sprite_x_[j] = sx;
-                j++;
-            }
-            n_next_sprites_ = j;
+            evaluateSprites();
 #endif
         }
         else if ( tick_ < 337 ) {
@@ -412,32 +315,307 @@ void PPU::frame()
     }
 }
 
+void PPU::incrementX()
+{
+    if ( ppuaddr.bits.coarse_x < 31 ) {
+        ppuaddr.bits.coarse_x ++;
+    }
+    else {
+        ppuaddr.bits.coarse_x = 0;
+        // switch nametable 2000 <-> 2400, 2800 <-> 2C00
+        ppuaddr.bits.nametable ^= 1;
+    }
+}
+
+void PPU::incrementY()
+{
+    if ( ppuaddr.bits.fine_y < 7 ) {
+        ppuaddr.bits.fine_y ++;
+    }
+    else {
+        ppuaddr.bits.fine_y = 0;
+        if ( ppuaddr.bits.coarse_y == 29 ) {
+            ppuaddr.bits.coarse_y = 0;
+            ppuaddr.bits.nametable ^= 2;
+        }
+        else if ( ppuaddr.bits.coarse_y == 31 ) {
+            ppuaddr.bits.coarse_y = 0;
+        }
+        else {
+            ppuaddr.bits.coarse_y ++;
+        }
+    }
+}
+
+void PPU::copyX()
+{
+    // copy t to v (horizontal part)
+    //v: ....F.. ...EDCBA = t: ....F.. ...EDCBA
+    ppuaddr.raw = (ppuaddr.raw & 0xFFBE0) | (ppuaddr_t.raw & 0x041F);
+}
+
+void PPU::evaluateSprites()
+{
+    // fetch sprites for the next scanline
+    uint16_t baseAddr = ctrl_.bits.sprite_pattern ? 0x1000 : 0;
+    int j = 0;
+    for ( int i = 0; (j < 8) && (i < 64); i++ ) {
+        uint8_t sy   = oam_[ i * 4 + 0 ];
+        uint8_t sx   = oam_[ i * 4 + 3 ];
+        uint8_t idx  = oam_[ i * 4 + 1 ];
+        uint8_t att  = oam_[ i * 4 + 2 ];
+        if ( sy > 0xef ) {
+            continue;
+        }
+        if ( scanline_ >= sy + 8 || scanline_ < sy ) {
+            continue;
+        }
+        int dy = scanline_-sy;
+        if (att & 0x80) { // vertical flip
+            dy = 7 - dy;
+        }
+        memcpy( &oam2_[j*4], &oam_[i*4], 4 );
+        const uint8_t* row = pattern( baseAddr + (idx*16) + dy );
+        if ( att & 0x40 ) { // horizontal flip
+            uint8_t c[8];
+            decodePatternRow( row[0], row[8], c );
+            for ( int k = 0; k < 8; k++ ) {
+                next_sprites_[j][k] = c[7 - k];
+            }
+        }
+        else {
+            decodePatternRow( row[0], row[8], next_sprites_[j] );
+        }
+        sprite_x_[j] = sx;
+        j++;
+    }
+    n_next_sprites_ = j;
+}
+
+void PPU::renderScanline()
+{
+    NES_TRACE_SCOPE( Render );
+    // Same result as frame() on ticks 0 to 340 of a visible scanline with
+    // the background enabled, when no register changes during the line.
+    //
+    // Sprites are evaluated once (frame() evaluates them again on each of
+    // ticks 0 and 256 to 320, always with the same result).
+    evaluateSprites();
+
+    uint8_t* line = &screen_[scanline_ * 256];
+    uint8_t palette0 = mem_[0x3F00];
+    uint16_t bg_addr = ctrl_.bits.background_pattern ? 0x1000 : 0;
+
+    // ticks 1 to 255, tiles are fetched every 8 ticks into the low half of
+    // the shift registers, the 8 next pixels start at fine_x
+    uint8_t* q = bg_pixels_;
+    memmove( &q[0], &q[bg_pos_], 8 );
+    for ( int k = 0; k < 32; k++ ) {
+        incrementX();
+        if ( !video_ && k < 30 ) {
+            // only the two last tiles are left in the shift registers
+            continue;
+        }
+        uint8_t nametable_byte = nametable( ppuaddr.raw );
+        const uint8_t* row = pattern( bg_addr + (nametable_byte << 4) + ppuaddr.bits.fine_y );
+        decodePatternRow( row[0], row[8], &q[8] );
+
+        const uint8_t* c = &q[fine_x_];
+        // the last tile only has 7 ticks left
+        int n = !video_ ? 0 : k < 31 ? 8 : 7;
+        uint8_t* p = line + 1 + k * 8;
+        for ( int i = 0; i < n; i++ ) {
+            p[i] = c[i] ? mem_[0x3F00 + c[i]] : palette0;
+        }
+        if ( k < 31 ) {
+            memcpy( &q[0], &q[8], 8 );
+        }
+    }
+    bg_pos_ = 7;
+
+    if ( mask_.bits.show_sprites ) {
+        // a sprite at X is output on ticks X+1 to X+8
+        // later sprites are drawn over earlier ones
+        for ( int i = 0; i < n_next_sprites_; i++ ) {
+            int x0 = sprite_x_[i] + 1;
+            if ( x0 > 255 ) {
+                continue;
+            }
+            status_.bits.sprite0_hit = 1;
+            if ( !video_ ) {
+                break;
+            }
+
+            uint8_t att = oam2_[ i * 4 + 2 ];
+            uint8_t pal = (att & 3) + 4;
+            const uint8_t* c = next_sprites_[i];
+            for ( int j = 0; (j < 8) && (x0 + j <= 255); j++ ) {
+                uint8_t sp_c = c[j];
+                if ( sp_c ) {
+                    line[x0 + j] = mem_[0x3F00 + pal * 4 + sp_c ];
+                }
+            }
+        }
+    }
+
+    // ticks 256 and 257
+    incrementY();
+    copyX();
+
+    lineDone();
+    time_ += 341;
+    scanline_++;
+}
+
 void PPU::render()
 {
-    // copy temporary screen to screen
-    //    memcpy( &screen_[0], &nametable_[0], 32*30*64 );
-        
-    uint8_t *rgb;
-    int pitch;
-    SDL_LockTexture( screen_tex_, NULL, (void**)&rgb, &pitch );
-    for ( size_t i = 0; i < 30*32*8*8; i++ ) {
-        rgb[i*3+0] = NesPalette[screen_[i]][0];
-        rgb[i*3+1] = NesPalette[screen_[i]][1];
-        rgb[i*3+2] = NesPalette[screen_[i]][2];
-    }
-    SDL_UnlockTexture( screen_tex_ );
-
-    SDL_RenderClear(renderer_);
-    SDL_RenderCopy(renderer_, screen_tex_, NULL, NULL);
-    SDL_RenderPresent(renderer_);
+    NES_TRACE_SCOPE( Present );
+    frames_++;
+    if ( frontend_ && video_ ) {
+        frontend_->present( &screen_[0], mask_.raw );
+    }
+}
+
+void PPU::saveState( State& state ) const
+{
+    memcpy( state.mem, &mem_[0], sizeof(state.mem) );
+    memcpy( state.oam, oam_, sizeof(state.oam) );
+    memcpy( state.oam2, oam2_, sizeof(state.oam2) );
+    memcpy( state.nextSprites, next_sprites_, sizeof(state.nextSprites) );
+    memcpy( state.bgPixels, bg_pixels_, sizeof(state.bgPixels) );
+    for ( int i = 0; i < 8; i++ ) {
+        state.spriteX[i] = sprite_x_[i];
+    }
+    state.time = time_;
+    state.nextEvent = nextEvent_;
+    state.frames = frames_;
+    state.tick = tick_;
+    state.scanline = scanline_;
+    state.writeLowAddr = write_low_addr_;
+    state.bgPos = bg_pos_;
+    state.nNextSprites = n_next_sprites_;
+    state.ppuaddr = ppuaddr.raw;
+    state.ppuaddrT = ppuaddr_t.raw;
+    state.status = status_.raw;
+    state.ctrl = ctrl_.raw;
+    state.mask = mask_.raw;
+    state.fineX = fine_x_;
+    state.oamAddr = oam_addr_;
+}
+
+void PPU::loadState( const State& state )
+{
+    memcpy( &mem_[0], state.mem, sizeof(state.mem) );
+    memcpy( oam_, state.oam, sizeof(state.oam) );
+    memcpy( oam2_, state.oam2, sizeof(state.oam2) );
+    memcpy( next_sprites_, state.nextSprites, sizeof(state.nextSprites) );
+    memcpy( bg_pixels_, state.bgPixels, sizeof(state.bgPixels) );
+    for ( int i = 0; i < 8; i++ ) {
+        sprite_x_[i] = state.spriteX[i];
+    }
+    time_ = state.time;
+    nextEvent_ = state.nextEvent;
+    frames_ = state.frames;
+    tick_ = state.tick;
+    scanline_ = state.scanline;
+    write_low_addr_ = state.writeLowAddr;
+    bg_pos_ = state.bgPos;
+    n_next_sprites_ = state.nNextSprites;
+    ppuaddr.raw = state.ppuaddr;
+    ppuaddr_t.raw = state.ppuaddrT;
+    status_.raw = state.status;
+    ctrl_.raw = state.ctrl;
+    mask_.raw = state.mask;
+    fine_x_ = state.fineX;
+    oam_addr_ = state.oamAddr;
+}
+
+void PPU::sync()
+{
+    sync( uint64_t( cpu_->cycleCount ) * 3 );
+}
+
+void PPU::sync( uint64_t target )
+{
+    NES_TRACE_SCOPE( Ppu );
+    while ( time_ < target ) {
+        if ( scanline_ < 240 && mask_.bits.show_background ) {
+            // rendering
+            if ( renderMode_ == RenderScanline && tick_ == 0 && target - time_ >= 341 ) {
+                // the whole scanline at once
+                renderScanline();
+            }
+            else {
+                // work on each tick
+                tick();
+            }
+            continue;
+        }
+        // nothing to do on each tick, jump to the end of the scanline
+        int n = 341 - tick_;
+        if ( target - time_ < uint64_t( n ) ) {
+            n = target - time_;
+        }
+        skip( n );
+    }
+
+    // next presentation (line 240, tick 0) or vblank (line 241, tick 1)
+    const int frameTicks = 262 * 341;
+    int pos = scanline_ * 341 + tick_;
+    int toRender = (240 * 341 - pos + frameTicks) % frameTicks + 1;
+    int toVBlank = (241 * 341 + 1 - pos + frameTicks) % frameTicks;
+    if ( toVBlank == 0 ) {
+        toVBlank = frameTicks;
+    }
+    int next = std::min( toRender, toVBlank );
+    if ( lineCounter_ ) {
+        // end of the current scanline
+        next = std::min( next, 341 - tick_ );
+    }
+    nextEvent_ = time_ + next;
+}
+
+void PPU::skip( int n )
+{
+    // what frame() does on these ticks
+    int last = tick_ + n - 1;
+    if ( scanline_ == 261 && tick_ <= 304 && last >= 280 ) {
+        //v: IHGF.ED CBA..... = t: IHGF.ED CBA.....
+        ppuaddr.raw = (ppuaddr.raw & 0xFF41F) | (ppuaddr_t.raw & 0x7BE0);
+    }
+    if ( scanline_ == 240 && tick_ == 0 ) {
+        render();
+    }
+
+    // and what tick() does when reaching tick 1
+    bool tick1 = tick_ == 0;
+    tick_ += n;
+    time_ += n;
+    if ( tick1 && scanline_ == 241 ) {
+        status_.bits.vblank = 1;
+        if ( ctrl_.bits.nmi ) {
+            cpu_->triggerNMI();
+        }
+    }
+    if ( tick1 && scanline_ == 261 ) {
+        status_.bits.vblank = 0;
+        status_.bits.sprite0_hit = 0;
+    }
+    if ( tick_ == 341 ) {
+        lineDone();
+        tick_ = 0;
+        scanline_ = (scanline_ + 1) % 262;
+    }
 }
 
 void PPU::tick()
 {
     frame();
+    time_++;
 
     tick_ = (tick_ + 1) % 341;
     if (tick_ == 0 ) {
+        lineDone();
         scanline_ = (scanline_ + 1) % 262;
     }
 
@@ -459,9 +637,12 @@ void PPU::tick()
 
 uint8_t PPU::read( uint16_t addr ) const
 {
+    // bring the PPU up to date before the CPU looks at it
+    const_cast<PPU*>( this )->sync();
+
     if ( addr > 7 ) {
-        printf("Trying to read to PPU register #%x\n", addr );
-        throw OutOfBoundAddress();
+        cpu_->raise( Fault::BadAddress, 0x2000 + addr );
+        return 0;
     }
     if ( addr == PPUStatus ) {
         uint8_t c = status_.raw;
@@ -472,10 +653,19 @@ uint8_t PPU::read( uint16_t addr ) const
     }
     else if ( addr == PPUData ) {
         uint16_t addr = ppuaddr.raw & 0x3FFF;
-        uint8_t b = mem_[ addr ];
-        if ( addr == 0x3F10 || addr == 0x3F14 || addr == 0x3F18 || addr == 0x3F1C ) {
+        uint8_t b;
+        if ( addr < 0x2000 ) {
+            b = *pattern( addr );
+        }
+        else if ( addr < 0x3F00 ) {
+            b = nametable( addr );
+        }
+        else if ( addr == 0x3F10 || addr == 0x3F14 || addr == 0x3F18 || addr == 0x3F1C ) {
             b = mem_[ addr - 0x10 ];
         }
+        else {
+            b = mem_[ addr ];
+        }
         ppuaddr.raw = ppuaddr.raw + (ctrl_.bits.vram_increment ? 32 : 1 );
         return b;
     }
@@ -492,9 +682,11 @@ uint8_t PPU::read( uint16_t addr ) const
 
 void PPU::write( uint16_t addr, uint8_t val )
 {
+    sync();
+
     if ( addr > 7 ) {
-        printf("Trying to write to PPU register #%x\n", addr );
-        throw OutOfBoundAddress();
+        cpu_->raise( Fault::BadAddress, 0x2000 + addr );
+        return;
     }
     if ( addr == PPUCtrl ) {
         ctrl_.raw = val;
@@ -522,7 +714,16 @@ void PPU::write( uint16_t addr, uint8_t val )
     }
     else if ( addr == PPUData ) {
         addr = ppuaddr.raw & 0x3FFF;
-        if ( addr == 0x3F10 || addr == 0x3F14 || addr == 0x3F18 || addr == 0x3F1C ) {
+        if ( addr < 0x2000 ) {
+            // CHR ROM is not writable
+            if ( patternsWritable_[addr >> 10] ) {
+                patterns_[addr >> 10][addr & 0x3FF] = val;
+            }
+        }
+        else if ( addr < 0x3F00 ) {
+            nametable( addr ) = val;
+        }
+        else if ( addr == 0x3F10 || addr == 0x3F14 || addr == 0x3F18 || addr == 0x3F1C ) {
             mem_[ addr - 0x10 ] = val;
         }
         else {
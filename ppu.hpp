@@ -1,8 +1,13 @@
+#ifndef NES_PPU_HPP
+#define NES_PPU_HPP
+
 #include <vector>
-#include "SDL.h"
+#include <string>
 #include "bus_device.hpp"
 
 class CPU;
+class Frontend;
+class Mapper;
 
 class PPU : public BusDevice
 {
@@ -16,7 +21,7 @@ class PPU : public BusDevice
     static const int PPUAddr =   6;
     static const int PPUData =   7;
 
-    PPU( CPU* cpu );
+    PPU( CPU* cpu, Frontend* frontend );
     ~PPU();
 
     uint8_t read( uint16_t addr ) const;
@@ -27,8 +32,69 @@ class PPU : public BusDevice
     // called on each frame
     void frame();
 
+    // Catch-up scheduling
+    // The PPU is left idle while the CPU runs and advanced in bulk to the
+    // current CPU time (3 ticks per CPU cycle) when one of its registers
+    // is accessed or when the next event is due.
+    void sync();
+    // advance up to target only, when the CPU has not looked at the PPU
+    // since (waking up for an event): whole scanlines are then rendered
+    // at once even when the CPU is a few ticks ahead
+    void sync( uint64_t target );
+    // tick at which the PPU must be synchronized at the latest:
+    // next frame presentation or vertical blank (NMI), and the end of
+    // each scanline when the mapper counts them
+    uint64_t nextEvent() const { return nextEvent_; }
+    // ticks since power on
+    uint64_t time() const { return time_; }
+    // frames presented since power on
+    uint64_t frameCount() const { return frames_; }
+
+    // Rendering of the visible scanlines
+    enum RenderMode
+    {
+        // tick by tick, follows mid-scanline changes of the registers
+        RenderDot,
+        // whole scanlines at once when the PPU catches up on complete
+        // lines, same output as RenderDot without mid-scanline changes
+        RenderScanline
+    };
+    void setRenderMode( RenderMode mode ) { renderMode_ = mode; }
+
+    // When disabled, frames are run but the scanline renderer does not
+    // draw them and they are not presented. The state seen by the CPU
+    // (registers, sprite 0 hit) is the same.
+    void setVideo( bool enabled ) { video_ = enabled; }
+    bool video() const { return video_; }
+
     std::vector<uint8_t>& memory() { return mem_; }
 
+    // Cartridge side of the PPU bus
+    // The pattern tables ($0000-$1FFF) are seen through 8 banks of 1 KB
+    // and the nametables ($2000-$2FFF, mirrored up to $3EFF) through 4
+    // banks of 1 KB. Mappers switch banks by changing the pointers.
+    // Before any mapping, all of them point to memory().
+    enum Mirroring
+    {
+        MirrorHorizontal,
+        MirrorVertical,
+        MirrorSingleLow,
+        MirrorSingleHigh,
+        MirrorFourScreen
+    };
+    void mapPatterns( int bank, uint8_t* mem, bool writable )
+    {
+        patterns_[bank] = mem;
+        patternsWritable_[bank] = writable;
+    }
+    void setMirroring( Mirroring mirroring );
+
+    // the mapper is told about each rendered scanline, when it counts them
+    void setMapper( Mapper* mapper );
+
+    // last complete frame, 256x240 palette indices
+    const uint8_t* screen() const { return &screen_[0]; }
+
     // current tick wihtin the scanline
     int ticks() const { return tick_; }
     // current scanline
@@ -47,21 +113,94 @@ class PPU : public BusDevice
 
     void dump_mem( const std::string& out_file ) const;
 
+    // present the frame to the frontend
     void render();
 
+    // Saved state, all that changes while running (the last frame and
+    // the settings are not part of it)
+    struct State
+    {
+        uint8_t mem[0x4000];
+        uint8_t oam[64*4];
+        uint8_t oam2[8*4];
+        uint8_t nextSprites[8][8];
+        uint8_t bgPixels[32];
+        int32_t spriteX[8];
+        uint64_t time;
+        uint64_t nextEvent;
+        uint64_t frames;
+        int32_t tick;
+        int32_t scanline;
+        int32_t writeLowAddr;
+        int32_t bgPos;
+        int32_t nNextSprites;
+        uint16_t ppuaddr;
+        uint16_t ppuaddrT;
+        uint8_t status;
+        uint8_t ctrl;
+        uint8_t mask;
+        uint8_t fineX;
+        uint8_t oamAddr;
+    };
+    void saveState( State& state ) const;
+    void loadState( const State& state );
+
  private:
     // 8 registers
     uint8_t regs[8];
 
-    SDL_Window* win_;
-    SDL_Renderer* renderer_;
+    Frontend* frontend_;
 
     std::vector<uint8_t> mem_;
     std::vector<uint8_t> screen_;
 
+    uint8_t* patterns_[8];
+    bool patternsWritable_[8];
+    uint8_t* nametables_[4];
+    // mapper counting the scanlines, or 0
+    Mapper* lineCounter_;
+
+    // 16 bytes of the pattern at addr, a pattern never crosses a bank
+    const uint8_t* pattern( uint16_t addr ) const
+    {
+        return patterns_[addr >> 10] + (addr & 0x3FF);
+    }
+    uint8_t& nametable( uint16_t addr )
+    {
+        return nametables_[(addr >> 10) & 3][addr & 0x3FF];
+    }
+    uint8_t nametable( uint16_t addr ) const
+    {
+        return nametables_[(addr >> 10) & 3][addr & 0x3FF];
+    }
+    // end of a scanline, counted by the mapper when rendering
+    void lineDone();
+
     int tick_;
     int scanline_;
 
+    // ticks since power on
+    uint64_t time_;
+    uint64_t nextEvent_;
+    uint64_t frames_;
+
+    RenderMode renderMode_;
+    bool video_;
+
+    // advance n ticks on the current scanline without per tick work
+    void skip( int n );
+    // render a visible scanline and advance to the next one
+    void renderScanline();
+
+    // coarse X, Y increments and horizontal copy of the vram address
+    void incrementX();
+    void incrementY();
+    void copyX();
+    // fill the sprites of the next scanline
+    void evaluateSprites();
+    // times evaluateSprites (microbench.cpp)
+    friend struct MicroBench;
+
 public:
     // status register
     // 7654 3210
@@ -223,7 +362,12 @@ private:
     // toggle high/low address (shared by ppuaddr and ppuscroll)
     mutable int write_low_addr_;
 
-    mutable uint16_t bg_shift_l, bg_shift_h;
+    // background shift registers, as decoded pixels (2 bits color indices)
+    // of the two fetched tiles followed by zeros
+    // the next pixel is bg_pixels_[bg_pos_ + fine_x_]
+    uint8_t bg_pixels_[32];
+    // pixels shifted out since the last tile fetch (at most 16)
+    int bg_pos_;
 
     CPU* cpu_;
 
@@ -232,8 +376,8 @@ private:
     uint8_t oam2_[8*4];
     uint8_t oam_addr_;
 
-    // sprites for the next scanline
-    uint8_t next_sprites_[8][2];
+    // decoded row of the sprites for the next scanline, flip applied
+    uint8_t next_sprites_[8][8];
     // X coordinate for sprites of the next scanline
     int sprite_x_[8];
     int n_next_sprites_;
@@ -242,11 +386,11 @@ private:
     // each cell contains a pixel value
     std::vector<uint8_t> nametable_;
 
-    // SDL texture used for screen framebuffer
-    SDL_Texture *screen_tex_;
 };
 
 std::ostream& operator<<( std::ostream& ostr, const PPU::Status& adr );
 std::ostream& operator<<( std::ostream& ostr, const PPU::Controller& adr );
 std::ostream& operator<<( std::ostream& ostr, const PPU::Mask& adr );
 std::ostream& operator<<( std::ostream& ostr, const PPU::Address& adr );
+
+#endif
@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+#include "cpu.hpp"
+#include "profiler.hpp"
+
+Profiler::Profiler() : frameLog_( 0 )
+{
+    reset();
+}
+
+void Profiler::reset()
+{
+    memset( opcodes_, 0, sizeof(opcodes_) );
+    Counter zero = { 0, 0 };
+    pcs_.assign( 0x10000, zero );
+    memset( frameOpcodes_, 0, sizeof(frameOpcodes_) );
+    // root: the code run from reset
+    Node root = { -1, Call, 0, 0 };
+    nodes_.assign( 1, root );
+    children_.clear();
+    stack_.clear();
+    current_ = 0;
+    frames_ = 0;
+}
+
+void Profiler::call( int kind, uint16_t target, uint8_t sp, int pushed )
+{
+    // the frames left without a return (PLA PLA JMP, jump back to the
+    // main loop) are above the stack pointer of the caller
+    leave( sp + pushed );
+    if ( stack_.size() >= MaxDepth ) {
+        stack_.erase( stack_.begin() );
+    }
+    Frame frame = { current_, sp };
+    stack_.push_back( frame );
+    current_ = child( current_, kind, target );
+}
+
+void Profiler::leave( int sp )
+{
+    size_t n = stack_.size();
+    while ( n > 0 && stack_[n - 1].sp < sp ) {
+        n--;
+    }
+    if ( n < stack_.size() ) {
+        // back in the code of the outermost frame left
+        current_ = stack_[n].caller;
+        stack_.resize( n );
+    }
+}
+
+int Profiler::child( int node, int kind, uint16_t addr )
+{
+    uint64_t key = (uint64_t( node ) << 20) | (uint64_t( kind ) << 16) | addr;
+    std::unordered_map<uint64_t, int>::const_iterator it = children_.find( key );
+    if ( it != children_.end() ) {
+        return it->second;
+    }
+    Node n = { node, kind, addr, 0 };
+    nodes_.push_back( n );
+    int id = nodes_.size() - 1;
+    children_[key] = id;
+    return id;
+}
+
+void Profiler::setFrameLog( FILE* log )
+{
+    frameLog_ = log;
+    if ( frameLog_ ) {
+        fprintf( frameLog_, "frame" );
+        for ( int i = 0; i < 256; i++ ) {
+            fprintf( frameLog_, ",%02X", i );
+        }
+        fprintf( frameLog_, "\n" );
+    }
+}
+
+void Profiler::endFrame()
+{
+    if ( frameLog_ ) {
+        fprintf( frameLog_, "%llu", (unsigned long long)frames_ );
+        for ( int i = 0; i < 256; i++ ) {
+            fprintf( frameLog_, ",%u", frameOpcodes_[i] );
+        }
+        fprintf( frameLog_, "\n" );
+    }
+    memset( frameOpcodes_, 0, sizeof(frameOpcodes_) );
+    frames_++;
+}
+
+void Profiler::writeCollapsed( std::ostream& ostr ) const
+{
+    std::vector<std::string> names( nodes_.size() );
+    // parents come first in nodes_
+    names[0] = "main";
+    for ( size_t i = 1; i < nodes_.size(); i++ ) {
+        const Node& n = nodes_[i];
+        char name[16];
+        snprintf( name, sizeof(name), "%s%04X", n.kind == Nmi ? "nmi_" : n.kind == Irq ? "irq_" : "", n.addr );
+        names[i] = names[n.parent] + ";" + name;
+    }
+    for ( size_t i = 0; i < nodes_.size(); i++ ) {
+        if ( nodes_[i].cycles ) {
+            ostr << names[i] << " " << nodes_[i].cycles << "\n";
+        }
+    }
+}
+
+void Profiler::writeOpcodes( std::ostream& ostr ) const
+{
+    // by cycles, descending
+    std::vector<std::pair<uint64_t, int> > order;
+    uint64_t total = 0;
+    for ( int i = 0; i < 256; i++ ) {
+        if ( opcodes_[i].count ) {
+            order.push_back( std::make_pair( opcodes_[i].cycles, i ) );
+            total += opcodes_[i].cycles;
+        }
+    }
+    std::sort( order.rbegin(), order.rend() );
+
+    ostr << "opcode mnemonic addressing executions cycles %" << std::endl;
+    const InstructionDefinition* table = InstructionDefinition::table();
+    for ( size_t i = 0; i < order.size(); i++ ) {
+        int op = order[i].second;
+        const Counter& c = opcodes_[op];
+        const InstructionDefinition& def = table[op];
+        char line[128];
+        snprintf( line, sizeof(line), "%02X %-4s %-12s %12llu %14llu %6.2f", op,
+                  InstructionDefinition::MnemonicString[def.mnemonic], AddressingString[def.addressing],
+                  (unsigned long long)c.count, (unsigned long long)c.cycles,
+                  total ? c.cycles * 100.0 / total : 0.0 );
+        ostr << line << std::endl;
+    }
+}
+
+void Profiler::writeHotspots( std::ostream& ostr, size_t n ) const
+{
+    // by cycles, descending
+    std::vector<std::pair<uint64_t, int> > order;
+    uint64_t total = 0;
+    for ( int i = 0; i < 0x10000; i++ ) {
+        if ( pcs_[i].count ) {
+            order.push_back( std::make_pair( pcs_[i].cycles, i ) );
+            total += pcs_[i].cycles;
+        }
+    }
+    n = std::min( n, order.size() );
+    std::partial_sort( order.begin(), order.begin() + n, order.end(),
+                       std::greater<std::pair<uint64_t, int> >() );
+
+    ostr << "pc executions cycles %" << std::endl;
+    for ( size_t i = 0; i < n; i++ ) {
+        const Counter& c = pcs_[order[i].second];
+        char line[96];
+        snprintf( line, sizeof(line), "%04X %12llu %14llu %6.2f", order[i].second,
+                  (unsigned long long)c.count, (unsigned long long)c.cycles,
+                  total ? c.cycles * 100.0 / total : 0.0 );
+        ostr << line << std::endl;
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef NES_PROFILER_HPP
+#define NES_PROFILER_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+///
+/// Where the guest spends its cycles
+///
+/// Counts the executions and the cycles of each opcode and of each
+/// address, and follows the subroutines of the guest with a shadow call
+/// stack: JSR and the interrupts push a frame, with the guest stack
+/// pointer. A frame is left once the stack pointer goes back above it,
+/// the return address popped: by RTS and RTI, but also by PLA PLA, a TXS
+/// reset or a jump back to the main loop, seen on the next call or return.
+/// An RTS used as a jump (the address pushed by the callee) stays in the
+/// callee. The cycles are accumulated per call path, in a tree of the
+/// paths seen, and exported as collapsed stacks for the flame graph tools.
+///
+/// The counting is a few array increments per instruction, it can stay on
+/// for long runs.
+class Profiler
+{
+public:
+    Profiler();
+
+    /// Forget everything
+    void reset();
+
+    /// The instruction at pc took cycles, next and sp are the pc and the
+    /// stack pointer after it
+    void count( uint16_t pc, uint8_t opcode, int cycles, uint16_t next, uint8_t sp )
+    {
+        opcodes_[opcode].count++;
+        opcodes_[opcode].cycles += cycles;
+        pcs_[pc].count++;
+        pcs_[pc].cycles += cycles;
+        frameOpcodes_[opcode]++;
+        nodes_[current_].cycles += cycles;
+        switch ( opcode )
+        {
+        case 0x20: // JSR
+            call( Call, next, sp, 2 );
+            break;
+        case 0x40: // RTI
+        case 0x60: // RTS
+        case 0x9A: // TXS
+            ret( sp );
+            break;
+        }
+    }
+
+    enum Interrupt
+    {
+        Nmi = 1,
+        Irq
+    };
+    /// The CPU entered the handler at target, sp after pushing the return
+    /// address and the status
+    void interrupt( Interrupt kind, uint16_t target, uint8_t sp, int cycles )
+    {
+        call( kind, target, sp, 3 );
+        nodes_[current_].cycles += cycles;
+    }
+
+    /// End of a video frame, the opcode counts of the frame are written to
+    /// the frame log if any
+    void endFrame();
+
+    /// CSV of the opcode counts of each frame, one line per frame
+    /// The file is not owned, 0 to stop.
+    void setFrameLog( FILE* log );
+
+    uint64_t frames() const { return frames_; }
+
+    /// Collapsed stacks: one line per call path, "main;C5F5;D900 cycles"
+    void writeCollapsed( std::ostream& ostr ) const;
+    /// Executions and cycles of each opcode, by cycles
+    void writeOpcodes( std::ostream& ostr ) const;
+    /// The n addresses that took the most cycles
+    void writeHotspots( std::ostream& ostr, size_t n ) const;
+
+private:
+    struct Counter
+    {
+        uint64_t count;
+        uint64_t cycles;
+    };
+
+    // node kinds: subroutine or interrupt handler
+    static const int Call = 0;
+
+    // call path: the path of the parent, then addr
+    struct Node
+    {
+        int parent;
+        int kind;
+        uint16_t addr;
+        uint64_t cycles;
+    };
+
+    struct Frame
+    {
+        // node to come back to
+        int caller;
+        // guest stack pointer in the callee, the return address is above
+        uint8_t sp;
+    };
+
+    // as many frames as return addresses fit in the guest stack, more
+    // only if the stack pointer wrapped around
+    static const size_t MaxDepth = 128;
+
+    // pushed: bytes pushed by the call, sp is after them
+    void call( int kind, uint16_t target, uint8_t sp, int pushed );
+    void ret( uint8_t sp )
+    {
+        // usually nothing to leave for a TXS, the last frame for a return
+        if ( !stack_.empty() && stack_.back().sp < sp ) {
+            leave( sp );
+        }
+    }
+    // leave the frames whose return address is above sp
+    void leave( int sp );
+    // node of the path of node followed by (kind, addr)
+    int child( int node, int kind, uint16_t addr );
+
+    Counter opcodes_[256];
+    std::vector<Counter> pcs_;
+    uint32_t frameOpcodes_[256];
+
+    std::vector<Node> nodes_;
+    std::unordered_map<uint64_t, int> children_;
+    std::vector<Frame> stack_;
+    // node of the running code
+    int current_;
+
+    FILE* frameLog_;
+    uint64_t frames_;
+};
+
+#endif
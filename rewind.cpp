@@ -0,0 +1,184 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "rewind.hpp"
+#include "console.hpp"
+
+namespace
+{
+
+// equal runs shorter than this are left inside the literals
+const int MinRun = 4;
+
+uint64_t load64( const uint8_t* p )
+{
+    uint64_t v;
+    memcpy( &v, p, 8 );
+    return v;
+}
+
+// 7 bits per byte, high bit set when more bytes follow
+size_t putVarint( uint8_t* out, size_t v )
+{
+    size_t n = 0;
+    while ( v >= 0x80 ) {
+        out[n++] = uint8_t(v) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = uint8_t(v);
+    return n;
+}
+
+size_t getVarint( const uint8_t* in, size_t& pos )
+{
+    size_t v = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+        b = in[pos++];
+        v |= size_t(b & 0x7F) << shift;
+        shift += 7;
+    } while ( b & 0x80 );
+    return v;
+}
+
+}
+
+Rewind::Rewind( size_t bufferSize, int interval ) : interval_( std::max( interval, 1 ) ),
+                                                    frames_( 0 ),
+                                                    current_( new SaveState ),
+                                                    next_( new SaveState ),
+                                                    ring_( bufferSize ),
+                                                    head_( 0 ),
+                                                    used_( 0 ),
+                                                    // entries are rarely smaller than that
+                                                    entries_( bufferSize / 256 + 1 ),
+                                                    first_( 0 ),
+                                                    count_( 0 ),
+                                                    // a token of two varints for each literal
+                                                    scratch_( 2 * sizeof( SaveState ) + 16 )
+{
+    // the first snapshot is stored as a difference to zeros
+    memset( current_, 0, sizeof( SaveState ) );
+    memset( next_, 0, sizeof( SaveState ) );
+}
+
+Rewind::~Rewind()
+{
+    delete current_;
+    delete next_;
+}
+
+void Rewind::record( const Console& console )
+{
+    if ( ++frames_ < interval_ ) {
+        return;
+    }
+    frames_ = 0;
+    console.save( *next_ );
+    push( encode( (const uint8_t*)next_, (const uint8_t*)current_, sizeof( SaveState ) ) );
+    std::swap( current_, next_ );
+}
+
+bool Rewind::rewind( Console& console )
+{
+    if ( count_ == 0 ) {
+        return false;
+    }
+    console.restore( *current_ );
+    // back to the snapshot before
+    pop();
+    decode( (uint8_t*)current_, sizeof( SaveState ) );
+    frames_ = 0;
+    return true;
+}
+
+size_t Rewind::encode( const uint8_t* a, const uint8_t* b, size_t n )
+{
+    uint8_t* out = &scratch_[0];
+    size_t o = 0;
+    size_t i = 0;
+    while ( i < n ) {
+        // equal bytes, a word at a time
+        size_t start = i;
+        while ( i + 8 <= n && load64( a + i ) == load64( b + i ) ) {
+            i += 8;
+        }
+        while ( i < n && a[i] == b[i] ) {
+            i++;
+        }
+        o += putVarint( out + o, i - start );
+
+        // different bytes, up to the next long enough equal run
+        start = i;
+        int same = 0;
+        while ( i < n && same < MinRun ) {
+            same = a[i] == b[i] ? same + 1 : 0;
+            i++;
+        }
+        if ( same == MinRun ) {
+            i -= MinRun;
+        }
+        o += putVarint( out + o, i - start );
+        for ( size_t j = start; j < i; j++ ) {
+            out[o++] = a[j] ^ b[j];
+        }
+    }
+    return o;
+}
+
+void Rewind::decode( uint8_t* a, size_t n )
+{
+    const uint8_t* in = &scratch_[0];
+    size_t pos = 0;
+    size_t i = 0;
+    while ( i < n ) {
+        i += getVarint( in, pos );
+        size_t len = getVarint( in, pos );
+        for ( size_t j = 0; j < len; j++ ) {
+            a[i + j] ^= in[pos + j];
+        }
+        i += len;
+        pos += len;
+    }
+}
+
+void Rewind::push( size_t size )
+{
+    if ( size > ring_.size() ) {
+        // cannot be stored, the history starts again after it
+        count_ = 0;
+        used_ = 0;
+        head_ = 0;
+        return;
+    }
+    while ( count_ && (used_ + size > ring_.size() || count_ == entries_.size()) ) {
+        used_ -= entries_[first_].size;
+        first_ = (first_ + 1) % entries_.size();
+        count_--;
+    }
+
+    size_t part = std::min( size, ring_.size() - head_ );
+    memcpy( &ring_[head_], &scratch_[0], part );
+    memcpy( &ring_[0], &scratch_[part], size - part );
+
+    Entry& e = entries_[(first_ + count_) % entries_.size()];
+    e.offset = head_;
+    e.size = size;
+    count_++;
+    head_ = (head_ + size) % ring_.size();
+    used_ += size;
+}
+
+size_t Rewind::pop()
+{
+    const Entry& e = entries_[(first_ + count_ - 1) % entries_.size()];
+    size_t part = std::min( e.size, ring_.size() - e.offset );
+    memcpy( &scratch_[0], &ring_[e.offset], part );
+    memcpy( &scratch_[part], &ring_[0], e.size - part );
+    count_--;
+    head_ = e.offset;
+    used_ -= e.size;
+    return e.size;
+}
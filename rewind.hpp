@@ -0,0 +1,85 @@
+#ifndef NES_REWIND_HPP
+#define NES_REWIND_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "savestate.hpp"
+
+class Console;
+
+///
+/// History of console snapshots, to go back in time
+///
+/// A snapshot is taken every few frames. Only the last one is kept
+/// whole, the ring buffer holds for each of the others the XOR with its
+/// successor, run length encoded: consecutive frames differ by a few
+/// hundred bytes of RAM, VRAM and OAM, so a minute fits in a few MB.
+/// The oldest snapshots are dropped when the buffer is full.
+///
+/// Nothing is allocated after construction.
+class Rewind
+{
+public:
+    /// bufferSize: bytes of compressed history
+    /// interval: frames between two snapshots
+    Rewind( size_t bufferSize = 4 << 20, int interval = 2 );
+    ~Rewind();
+
+    /// To be called once per frame, takes a snapshot every interval frames
+    void record( const Console& console );
+
+    /// Restore the last snapshot and forget it
+    /// Returns false if the history is empty
+    bool rewind( Console& console );
+
+    /// Number of snapshots that can be restored
+    size_t size() const { return count_; }
+    /// Bytes of the buffer in use
+    size_t used() const { return used_; }
+
+private:
+    Rewind( const Rewind& );
+    Rewind& operator=( const Rewind& );
+
+    // run length encoding of a XOR b into scratch_, returns its size
+    size_t encode( const uint8_t* a, const uint8_t* b, size_t n );
+    // a ^= the encoded difference in scratch_
+    void decode( uint8_t* a, size_t n );
+
+    // append scratch_[0..size) as the newest entry, dropping old ones
+    void push( size_t size );
+    // copy the newest entry to scratch_ and remove it, returns its size
+    size_t pop();
+
+    struct Entry
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    int interval_;
+    int frames_;
+
+    // last snapshot, restored by the next rewind
+    SaveState* current_;
+    // snapshot being taken
+    SaveState* next_;
+
+    std::vector<uint8_t> ring_;
+    // where the next entry is written
+    size_t head_;
+    size_t used_;
+
+    // circular list of the entries, oldest first
+    std::vector<Entry> entries_;
+    size_t first_;
+    size_t count_;
+
+    // an encoded entry, large enough for the worst case
+    std::vector<uint8_t> scratch_;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "checksum.hpp"
+#include "rom_index.hpp"
+
+RomIndex::Entry RomIndex::describe( const NesFile& file )
+{
+    Entry entry;
+    memset( &entry, 0, sizeof(entry) );
+    entry.header = file.header();
+    // PRG and CHR are contiguous in the file
+    const uint8_t* rom = file.prg();
+    size_t romSize = file.prgSize() + file.chrSize();
+    entry.crc32 = crc32( rom, romSize );
+    sha1( rom, romSize, entry.sha1 );
+    entry.fileSize = file.size();
+    entry.mapper = file.header().mapper();
+    return entry;
+}
+
+void RomIndex::write( const std::string& path, const std::vector<Entry>& entries,
+                      const std::vector<std::string>& paths )
+{
+    std::vector<Entry> all( entries );
+    std::string strings;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        all[i].path = strings.size();
+        strings.append( paths[i].c_str(), paths[i].size() + 1 );
+    }
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.count = all.size();
+    header.pathsSize = strings.size();
+
+    FILE* fo = fopen( path.c_str(), "wb" );
+    if ( !fo ) {
+        throw std::runtime_error( "cannot create " + path );
+    }
+    bool ok = fwrite( &header, sizeof(header), 1, fo ) == 1 &&
+              (all.empty() || fwrite( &all[0], sizeof(Entry), all.size(), fo ) == all.size()) &&
+              fwrite( strings.data(), 1, strings.size(), fo ) == strings.size();
+    if ( fclose( fo ) != 0 || !ok ) {
+        throw std::runtime_error( "cannot write " + path );
+    }
+}
+
+RomIndex::RomIndex( const std::string& path ) : data_( 0 ),
+                                                size_( 0 )
+{
+    int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 ) {
+        throw std::runtime_error( "cannot open " + path );
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || size_t( st.st_size ) < sizeof(Header) ) {
+        close( fd );
+        throw std::runtime_error( "cannot read " + path );
+    }
+    size_ = st.st_size;
+    void* mem = mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( mem == MAP_FAILED ) {
+        throw std::runtime_error( "cannot map " + path );
+    }
+    data_ = (const uint8_t*)mem;
+
+    const Header& h = header();
+    if ( h.magic != Magic || h.version != Version ||
+         sizeof(Header) + size_t( h.count ) * sizeof(Entry) + h.pathsSize != size_ ) {
+        munmap( (void*)data_, size_ );
+        throw std::runtime_error( path + " is not a ROM index" );
+    }
+}
+
+RomIndex::~RomIndex()
+{
+    munmap( (void*)data_, size_ );
+}
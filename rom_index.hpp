@@ -0,0 +1,76 @@
+#ifndef NES_ROM_INDEX_HPP
+#define NES_ROM_INDEX_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "nes_file_importer.hpp"
+
+///
+/// Index of a ROM collection, written by nes_romscan
+///
+/// The file is a header, the fixed size entries, then the paths as
+/// null-terminated strings. It is mapped as is: opening an index of
+/// thousands of ROMs reads nothing but the pages looked at.
+class RomIndex
+{
+public:
+    static const uint32_t Magic = 0x4953454E; // "NESI" in the file
+    static const uint32_t Version = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+        // bytes of the path strings, after the entries
+        uint32_t pathsSize;
+    };
+
+    struct Entry
+    {
+        iNESHeader header;
+        // of the PRG and CHR ROMs, without header nor trainer, as in
+        // the ROM databases
+        uint32_t crc32;
+        uint8_t sha1[20];
+        uint32_t fileSize;
+        // offset of the path in the strings
+        uint32_t path;
+        uint16_t mapper;
+        uint16_t padding;
+    };
+
+    /// Entry of the ROM file mapped, the path is left to the writer
+    static Entry describe( const NesFile& file );
+
+    /// Write an index, paths[i] being the one of entries[i]
+    /// Throws std::runtime_error
+    static void write( const std::string& path, const std::vector<Entry>& entries,
+                       const std::vector<std::string>& paths );
+
+    /// Map an index
+    /// Throws std::runtime_error if the file cannot be read or is not an
+    /// index of this version
+    RomIndex( const std::string& path );
+    ~RomIndex();
+
+    size_t size() const { return header().count; }
+    const Entry& operator[]( size_t i ) const { return entries()[i]; }
+    const char* path( size_t i ) const { return paths() + entries()[i].path; }
+
+private:
+    RomIndex( const RomIndex& );
+    RomIndex& operator=( const RomIndex& );
+
+    const Header& header() const { return *(const Header*)data_; }
+    const Entry* entries() const { return (const Entry*)(data_ + sizeof(Header)); }
+    const char* paths() const { return (const char*)(entries() + size()); }
+
+    const uint8_t* data_;
+    size_t size_;
+};
+
+#endif
@@ -0,0 +1,209 @@
+// Indexes a ROM collection on all the cores
+//
+// The directories given on the command line are walked for .nes files.
+// Each one is mapped, checked and hashed (CRC-32 and SHA-1 of its ROMs)
+// by a worker, then the index is written in one go. --list prints an
+// index.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "checksum.hpp"
+#include "rom_index.hpp"
+#include "thread_pool.hpp"
+
+namespace
+{
+
+double now()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool isNesFile( const std::string& name )
+{
+    return name.size() > 4 && strcasecmp( name.c_str() + name.size() - 4, ".nes" ) == 0;
+}
+
+// .nes files under path, recursively
+void walk( const std::string& path, std::vector<std::string>& files )
+{
+    struct stat st;
+    if ( stat( path.c_str(), &st ) != 0 ) {
+        std::cerr << path << ": cannot read" << std::endl;
+        return;
+    }
+    if ( !S_ISDIR( st.st_mode ) ) {
+        files.push_back( path );
+        return;
+    }
+    DIR* dir = opendir( path.c_str() );
+    if ( !dir ) {
+        std::cerr << path << ": cannot read" << std::endl;
+        return;
+    }
+    while ( dirent* e = readdir( dir ) ) {
+        std::string name( e->d_name );
+        if ( name == "." || name == ".." ) {
+            continue;
+        }
+        std::string sub = path + "/" + name;
+        if ( stat( sub.c_str(), &st ) != 0 ) {
+            continue;
+        }
+        if ( S_ISDIR( st.st_mode ) ) {
+            walk( sub, files );
+        }
+        else if ( isNesFile( name ) ) {
+            files.push_back( sub );
+        }
+    }
+    closedir( dir );
+}
+
+///
+/// Hashes one ROM file
+class Scan : public ThreadPool::Task
+{
+public:
+    Scan( const std::string& path ) : path_( path ),
+                                      size_( 0 )
+    {
+    }
+
+    bool run()
+    {
+        try {
+            NesFile file( path_ );
+            entry_ = RomIndex::describe( file );
+            size_ = file.size();
+        }
+        catch ( std::exception& e ) {
+            error_ = e.what();
+        }
+        return false;
+    }
+
+    const std::string& path() const { return path_; }
+    const RomIndex::Entry& entry() const { return entry_; }
+    size_t size() const { return size_; }
+    const std::string& error() const { return error_; }
+
+private:
+    std::string path_;
+    RomIndex::Entry entry_;
+    size_t size_;
+    std::string error_;
+};
+
+int list( const std::string& path )
+{
+    RomIndex index( path );
+    for ( size_t i = 0; i < index.size(); i++ ) {
+        const RomIndex::Entry& e = index[i];
+        printf( "%08x ", e.crc32 );
+        for ( int k = 0; k < 20; k++ ) {
+            printf( "%02x", e.sha1[k] );
+        }
+        printf( " mapper %3d prg %3d chr %3d %s\n", e.mapper, e.header.PRGRomSize,
+                e.header.CHRRomSize, index.path( i ) );
+    }
+    return 0;
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    int threads = 0;
+    std::string output( "roms.idx" );
+    std::vector<std::string> paths;
+    for ( int i = 1; i < argc; i++ ) {
+        std::string arg( argv[i] );
+        if ( arg == "--threads" && i + 1 < argc ) {
+            threads = atoi( argv[++i] );
+        }
+        else if ( arg == "-o" && i + 1 < argc ) {
+            output = argv[++i];
+        }
+        else if ( arg == "--list" && i + 1 < argc ) {
+            try {
+                return list( argv[++i] );
+            }
+            catch ( std::exception& e ) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else {
+            paths.push_back( arg );
+        }
+    }
+    if ( paths.empty() ) {
+        std::cerr << "Arguments: [--threads n] [-o index] directory_or_nes_file..." << std::endl
+                  << "           --list index" << std::endl;
+        return 1;
+    }
+
+    double start = now();
+    std::vector<std::string> files;
+    for ( size_t i = 0; i < paths.size(); i++ ) {
+        walk( paths[i], files );
+    }
+    // same index for the same collection
+    std::sort( files.begin(), files.end() );
+
+    std::vector<Scan*> all;
+    std::vector<ThreadPool::Task*> tasks;
+    for ( size_t i = 0; i < files.size(); i++ ) {
+        all.push_back( new Scan( files[i] ) );
+        tasks.push_back( all.back() );
+    }
+    ThreadPool pool( threads );
+    pool.run( tasks );
+
+    std::vector<RomIndex::Entry> entries;
+    std::vector<std::string> indexed;
+    double bytes = 0;
+    int failed = 0;
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        if ( all[i]->error().empty() ) {
+            entries.push_back( all[i]->entry() );
+            indexed.push_back( all[i]->path() );
+            bytes += all[i]->size();
+        }
+        else {
+            std::cerr << all[i]->path() << ": " << all[i]->error() << std::endl;
+            failed++;
+        }
+        delete all[i];
+    }
+    try {
+        RomIndex::write( output, entries, indexed );
+    }
+    catch ( std::exception& e ) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    double elapsed = now() - start;
+
+    printf( "indexed %d ROMs (%.1f MB) in %.2f s with %d threads (%s) into %s\n",
+            int( entries.size() ), bytes / 1e6, elapsed, pool.size(), checksumNames(),
+            output.c_str() );
+    if ( failed ) {
+        printf( "%d files skipped\n", failed );
+    }
+    return 0;
+}
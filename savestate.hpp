@@ -0,0 +1,37 @@
+#ifndef NES_SAVESTATE_HPP
+#define NES_SAVESTATE_HPP
+
+#include <stdint.h>
+
+#include "cpu.hpp"
+#include "ppu.hpp"
+#include "apu.hpp"
+#include "controller.hpp"
+#include "mapper.hpp"
+
+///
+/// Snapshot of a console, in one contiguous block of plain data
+///
+/// It can be copied with memcpy and written as is to a file. The header
+/// allows to reject a snapshot of another version of the layout.
+struct SaveState
+{
+    // "NESS" (little endian)
+    static const uint32_t Magic = 0x5353454E;
+    // to increment when the layout changes
+    static const uint32_t Version = 3;
+
+    uint32_t magic;
+    uint32_t version;
+    // sizeof(SaveState)
+    uint32_t size;
+
+    CPU::State cpu;
+    uint8_t ram[2048];
+    PPU::State ppu;
+    APU::State apu;
+    Controller::State controller;
+    Mapper::State mapper;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "sdl_frontend.hpp"
+#include "palette.hpp"
+#include "controller.hpp"
+
+SDLFrontend::SDLFrontend() : win_( 0 ),
+                             renderer_( 0 ),
+                             screen_tex_( 0 ),
+                             colorMask_( 0 ),
+                             rewind_( false ),
+                             audio_( 0 ),
+                             sampleRate_( 0 ),
+                             targetFill_( 0 ),
+                             ring_( 16384 ),
+                             nextFrame_( 0 )
+{
+    SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_AUDIO );
+
+    win_ = SDL_CreateWindow( "Test", 0, 0, 512, 480, 0 );
+    if ( ! win_ ) {
+        throw std::runtime_error( "create window" );
+    }
+    renderer_ = SDL_CreateRenderer( win_, -1, 0 );
+    if ( ! renderer_ ) {
+        throw std::runtime_error( "create renderer" );
+    }
+
+    // RGB888 is XRGB8888
+    screen_tex_ = SDL_CreateTexture( renderer_,
+                                     SDL_PIXELFORMAT_RGB888,
+                                     SDL_TEXTUREACCESS_STREAMING,
+                                     32*8,
+                                     30*8 );
+
+    buildColorTable( colorMask_, colors_ );
+
+    SDL_AudioSpec want, have;
+    memset( &want, 0, sizeof(want) );
+    want.freq = 48000;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = &SDLFrontend::audioCallback;
+    want.userdata = this;
+    audio_ = SDL_OpenAudioDevice( NULL, 0, &want, &have, 0 );
+    if ( audio_ ) {
+        sampleRate_ = have.freq;
+        // the callback buffer plus two frames
+        targetFill_ = have.samples + 2 * sampleRate_ / 60;
+        SDL_PauseAudioDevice( audio_, 0 );
+    }
+}
+
+SDLFrontend::~SDLFrontend()
+{
+    if ( audio_ ) {
+        SDL_CloseAudioDevice( audio_ );
+    }
+    SDL_Quit();
+}
+
+void SDLFrontend::audioCallback( void* frontend, uint8_t* stream, int len )
+{
+    SDLFrontend* self = (SDLFrontend*)frontend;
+    size_t n = len / sizeof(int16_t);
+    size_t got = self->ring_.read( (int16_t*)stream, n );
+    // silence when the emulation is late or paused
+    memset( stream + got * sizeof(int16_t), 0, (n - got) * sizeof(int16_t) );
+}
+
+void SDLFrontend::playAudio( const int16_t* samples, size_t n )
+{
+    if ( !audio_ ) {
+        return;
+    }
+    // ahead of the audio output, sleep until the callback has consumed
+    // what exceeds the target
+    size_t fill = ring_.size();
+    if ( fill > targetFill_ ) {
+        SDL_Delay( uint32_t( (fill - targetFill_) * 1000 / sampleRate_ ) );
+    }
+    // dropped if the queue is full
+    ring_.write( samples, n );
+}
+
+double SDLFrontend::audioRateRatio() const
+{
+    if ( !audio_ ) {
+        return 1.0;
+    }
+    // up to half a percent more samples when the queue is low, less
+    // when it is high
+    double fill = double( ring_.size() );
+    double target = double( targetFill_ );
+    return 1.0 + 0.005 * std::max( -1.0, std::min( 1.0, (target - fill) / target ) );
+}
+
+void SDLFrontend::present( const uint8_t* screen, uint8_t mask )
+{
+    // colors for the grayscale and emphasis bits in effect at the end of
+    // the frame
+    uint8_t colorMask = mask & 0xE1;
+    if ( colorMask != colorMask_ ) {
+        buildColorTable( colorMask, colors_ );
+        colorMask_ = colorMask;
+    }
+
+    uint8_t *rgb;
+    int pitch;
+    SDL_LockTexture( screen_tex_, NULL, (void**)&rgb, &pitch );
+    for ( int y = 0; y < 240; y++ ) {
+        convertToXRGB( &screen[y*256], 256, colors_, (uint32_t*)(rgb + y*pitch) );
+    }
+    SDL_UnlockTexture( screen_tex_ );
+
+    SDL_RenderClear(renderer_);
+    SDL_RenderCopy(renderer_, screen_tex_, NULL, NULL);
+    SDL_RenderPresent(renderer_);
+
+    if ( !audio_ ) {
+        // no audio to follow, one frame every 1/60.1 s
+        uint64_t now = SDL_GetPerformanceCounter();
+        uint64_t frame = SDL_GetPerformanceFrequency() * 1000 / 60099;
+        if ( nextFrame_ == 0 || now > nextFrame_ + 5 * frame ) {
+            // too late, start again from now
+            nextFrame_ = now;
+        }
+        else if ( now < nextFrame_ ) {
+            SDL_Delay( uint32_t( (nextFrame_ - now) * 1000 / SDL_GetPerformanceFrequency() ) );
+        }
+        nextFrame_ += frame;
+    }
+}
+
+Frontend::Event SDLFrontend::poll( Controller& controller )
+{
+    SDL_Event e;
+    while ( SDL_PollEvent(&e) ) {
+        if ( e.type == SDL_QUIT ) {
+            return QuitEvent;
+        }
+        else if ( e.type == SDL_KEYDOWN || e.type == SDL_KEYUP ) {
+            SDL_KeyboardEvent* ke = (SDL_KeyboardEvent*)(&e);
+            bool pressed = ke->state == SDL_PRESSED;
+            if ( ke->keysym.sym == SDLK_ESCAPE ) {
+                return QuitEvent;
+            }
+            else if ( ke->keysym.sym == SDLK_RETURN ) {
+                controller.setState( 0, Controller::StartButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_SPACE ) {
+                controller.setState( 0, Controller::SelectButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_RIGHT ) {
+                controller.setState( 0, Controller::RightButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_LEFT ) {
+                controller.setState( 0, Controller::LeftButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_UP ) {
+                controller.setState( 0, Controller::UpButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_DOWN ) {
+                controller.setState( 0, Controller::DownButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_a ) {
+                controller.setState( 0, Controller::AButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_b ) {
+                controller.setState( 0, Controller::BButton, pressed );
+            }
+            else if ( ke->keysym.sym == SDLK_d && pressed ) {
+                return DebugEvent;
+            }
+            else if ( ke->keysym.sym == SDLK_BACKSPACE ) {
+                rewind_ = pressed;
+            }
+        }
+    }
+    return rewind_ ? RewindEvent : NoEvent;
+}
@@ -0,0 +1,60 @@
+#ifndef NES_SDL_FRONTEND_HPP
+#define NES_SDL_FRONTEND_HPP
+
+#include "SDL.h"
+#include "frontend.hpp"
+#include "audio_ring.hpp"
+
+///
+/// Window, keyboard and audio output through SDL2
+///
+/// The audio output paces the emulation: the samples of a frame are
+/// queued for the audio callback, and playAudio sleeps while more than
+/// a few frames are queued. The rate of the APU is adjusted a little
+/// so that the queue stays around that level instead of running dry or
+/// filling up. Without an audio device, present() paces the frames.
+class SDLFrontend : public Frontend
+{
+public:
+    SDLFrontend();
+    ~SDLFrontend();
+
+    void present( const uint8_t* screen, uint8_t mask );
+    void playAudio( const int16_t* samples, size_t n );
+    Event poll( Controller& controller );
+
+    /// Sample rate of the audio device, 0 without audio
+    int sampleRate() const { return sampleRate_; }
+    /// Ratio to apply to the rate of the APU to bring the queue back to
+    /// its target level
+    double audioRateRatio() const;
+
+private:
+    SDL_Window* win_;
+    SDL_Renderer* renderer_;
+    // screen framebuffer
+    SDL_Texture* screen_tex_;
+
+    // XRGB8888 colors of the palette entries, for the grayscale and
+    // emphasis bits of colorMask_
+    uint32_t colors_[64];
+    uint8_t colorMask_;
+
+    // the rewind key is down
+    bool rewind_;
+
+    // called by SDL from its audio thread
+    static void audioCallback( void* frontend, uint8_t* stream, int len );
+
+    SDL_AudioDeviceID audio_;
+    int sampleRate_;
+    // samples to keep queued
+    size_t targetFill_;
+    AudioRing ring_;
+
+    // performance counter value at which to present the next frame,
+    // without audio
+    uint64_t nextFrame_;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "superblock.hpp"
+
+SuperblockEngine::SuperblockEngine( CPU* cpu ) : cpu_( cpu )
+{
+}
+
+SuperblockEngine::~SuperblockEngine()
+{
+    invalidate();
+}
+
+void SuperblockEngine::invalidate()
+{
+    for ( size_t i = 0; i < blocks_.size(); i++ ) {
+        delete blocks_[i];
+    }
+    blocks_.clear();
+    for ( int p = 0; p < 256; p++ ) {
+        pages_[p].clear();
+    }
+    parked_.clear();
+}
+
+const Superblock* SuperblockEngine::find( uint16_t pc )
+{
+    int p = pc >> 8;
+    std::vector<Superblock*>& page = pages_[p];
+    const uint8_t* mem = cpu_->bus().pageMemory( pc );
+    if ( !page.empty() && memory_[p] != mem ) {
+        // bank switch, the blocks are kept for when the bank comes back
+        page.swap( parked_[std::make_pair( memory_[p], p )] );
+        Parked::iterator it = parked_.find( std::make_pair( mem, p ) );
+        if ( it != parked_.end() ) {
+            page.swap( it->second );
+            parked_.erase( it );
+        }
+    }
+    if ( page.empty() ) {
+        page.resize( 256, 0 );
+    }
+    memory_[p] = mem;
+    Superblock*& block = page[pc & 0xFF];
+    if ( !block ) {
+        block = discover( pc );
+    }
+    return block == &none_ ? 0 : block;
+}
+
+Superblock* SuperblockEngine::discover( uint16_t pc )
+{
+    const MemoryMap& bus = cpu_->bus();
+    Superblock* block = new Superblock;
+    block->maxCycles = 0;
+
+    uint16_t addr = pc;
+    int cycles = 0;
+    while ( block->ops.size() < MaxLength ) {
+        // only code from ROM, it cannot be modified behind our back
+        if ( !bus.isDirectRead( addr ) || bus.isDirectWrite( addr ) ||
+             !bus.isDirectRead( addr + 2 ) || bus.isDirectWrite( addr + 2 ) ) {
+            break;
+        }
+        Instruction instr = cpu_->decode( addr );
+        if ( !isSafe( instr ) || ((addr + instr.nOperands) >> 8) != (pc >> 8) ) {
+            break;
+        }
+
+        Superblock::MicroOp op;
+        op.instr = instr;
+        op.next = addr + instr.nOperands + 1;
+        cycles += instr.def->nCycles;
+        op.cycles = cycles;
+        block->ops.push_back( op );
+        // at most +1 for a page crossing or +2 for a taken branch
+        block->maxCycles += instr.def->nCycles + 2;
+
+        addr = op.next;
+        if ( isControlFlow( instr ) ) {
+            break;
+        }
+    }
+
+    if ( block->ops.empty() ) {
+        delete block;
+        return &none_;
+    }
+    blocks_.push_back( block );
+    return block;
+}
+
+bool SuperblockEngine::isControlFlow( const Instruction& instr )
+{
+    switch ( instr.def->mnemonic )
+    {
+    case InstructionDefinition::MNEMONIC_BPL:
+    case InstructionDefinition::MNEMONIC_BMI:
+    case InstructionDefinition::MNEMONIC_BVC:
+    case InstructionDefinition::MNEMONIC_BVS:
+    case InstructionDefinition::MNEMONIC_BCC:
+    case InstructionDefinition::MNEMONIC_BCS:
+    case InstructionDefinition::MNEMONIC_BNE:
+    case InstructionDefinition::MNEMONIC_BEQ:
+    case InstructionDefinition::MNEMONIC_JMP:
+    case InstructionDefinition::MNEMONIC_JSR:
+    case InstructionDefinition::MNEMONIC_RTS:
+    case InstructionDefinition::MNEMONIC_RTI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool SuperblockEngine::isSafe( const Instruction& instr ) const
+{
+    const MemoryMap& bus = cpu_->bus();
+    bool writes = InstructionDefinition::writesMemory( instr.def->mnemonic );
+    bool stack = false;
+
+    switch ( instr.def->mnemonic )
+    {
+    case InstructionDefinition::MNEMONIC_ILL:
+    case InstructionDefinition::MNEMONIC_BRK:
+        // fault, leave them to the per-instruction path
+        return false;
+    case InstructionDefinition::MNEMONIC_PHA:
+    case InstructionDefinition::MNEMONIC_PHP:
+    case InstructionDefinition::MNEMONIC_PLA:
+    case InstructionDefinition::MNEMONIC_PLP:
+    case InstructionDefinition::MNEMONIC_JSR:
+    case InstructionDefinition::MNEMONIC_RTS:
+    case InstructionDefinition::MNEMONIC_RTI:
+        stack = true;
+        break;
+    default:
+        break;
+    }
+
+    if ( stack && !(bus.isDirectRead( 0x100 ) && bus.isDirectWrite( 0x100 )) ) {
+        return false;
+    }
+    if ( writes && instr.addressing == InstructionDefinition::ADDRESSING_IMMEDIATE ) {
+        // no address to write to, not implemented: fault as ILL
+        return false;
+    }
+
+    // pages that may be accessed
+    uint16_t first, last;
+    uint16_t abs = instr.operand1 | (instr.operand2 << 8);
+    switch ( instr.addressing )
+    {
+    case InstructionDefinition::ADDRESSING_NONE:
+    case InstructionDefinition::ADDRESSING_IMMEDIATE:
+    case InstructionDefinition::ADDRESSING_ACCUMULATOR:
+    case InstructionDefinition::ADDRESSING_RELATIVE:
+        return true;
+    case InstructionDefinition::ADDRESSING_ZERO_PAGE:
+    case InstructionDefinition::ADDRESSING_ZERO_PAGE_X:
+    case InstructionDefinition::ADDRESSING_ZERO_PAGE_Y:
+        first = last = 0;
+        break;
+    case InstructionDefinition::ADDRESSING_ABSOLUTE:
+        if ( instr.def->mnemonic == InstructionDefinition::MNEMONIC_JMP ||
+             instr.def->mnemonic == InstructionDefinition::MNEMONIC_JSR ) {
+            // jump target, not an operand
+            return true;
+        }
+        first = last = abs;
+        break;
+    case InstructionDefinition::ADDRESSING_INDIRECT:
+        // pointer of JMP, wrapping within its page
+        first = last = abs;
+        break;
+    case InstructionDefinition::ADDRESSING_ABSOLUTE_X:
+    case InstructionDefinition::ADDRESSING_ABSOLUTE_Y:
+        first = abs;
+        last = abs + 0xFF;
+        break;
+    default:
+        // indirect indexed, the target is only known at run time
+        return false;
+    }
+
+    for ( int p = first >> 8; ; p = (p + 1) & 0xFF ) {
+        if ( !bus.isDirectRead( p << 8 ) ) {
+            return false;
+        }
+        if ( writes && !bus.isDirectWrite( p << 8 ) ) {
+            return false;
+        }
+        if ( p == (last >> 8) ) {
+            break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef NES_SUPERBLOCK_HPP
+#define NES_SUPERBLOCK_HPP
+
+#include <map>
+#include <vector>
+
+#include "cpu.hpp"
+#include "profiler.hpp"
+
+///
+/// Basic block of pre-decoded instructions, run in one call
+///
+/// A block is a straight sequence of instructions read from ROM. It ends
+/// with the first control flow instruction (branch, jump, return, ...)
+/// and stops before any instruction that could access a memory mapped
+/// register, since the other devices are only synchronized between blocks.
+/// It never crosses a page, so that it only depends on the bank of its page.
+struct Superblock
+{
+    struct MicroOp
+    {
+        // decoded instruction, with its specialized handler
+        Instruction instr;
+        // address of the next instruction
+        uint16_t next;
+        // base cycles from the start of the block, this instruction included
+        int cycles;
+    };
+    std::vector<MicroOp> ops;
+
+    // upper bound of the cycles spent in the block
+    // (base cycles + page crossings + taken branch)
+    int maxCycles;
+};
+
+class SuperblockEngine
+{
+public:
+    SuperblockEngine( CPU* cpu );
+    ~SuperblockEngine();
+
+    /// Block starting at pc, discovered on first call
+    /// Returns 0 if the instruction at pc must run on the per-instruction path
+    const Superblock* find( uint16_t pc );
+
+    /// Run all the instructions of a block
+    /// cycles are accumulated in cpu->cycles
+    void run( const Superblock& block )
+    {
+        const Superblock::MicroOp* op = &block.ops[0];
+        const Superblock::MicroOp* end = op + block.ops.size();
+        for ( ; op != end; ++op ) {
+            cpu_->pc = op->next;
+            op->instr.handler( *cpu_, op->instr );
+        }
+    }
+
+    /// Same as run(), counting each instruction in profiler
+    void runProfiled( const Superblock& block, Profiler& profiler )
+    {
+        const Superblock::MicroOp* op = &block.ops[0];
+        const Superblock::MicroOp* end = op + block.ops.size();
+        uint16_t pc = cpu_->pc;
+        for ( ; op != end; ++op ) {
+            int cycles = cpu_->cycles;
+            cpu_->pc = op->next;
+            op->instr.handler( *cpu_, op->instr );
+            profiler.count( pc, op->instr.opcode, cpu_->cycles - cycles, cpu_->pc, cpu_->sp );
+            pc = op->next;
+        }
+    }
+
+    /// Forget all blocks (when the ROM mapping changes)
+    void invalidate();
+
+    // maximum number of instructions in a block
+    static const size_t MaxLength = 32;
+
+private:
+    Superblock* discover( uint16_t pc );
+    // true if the instruction only touches plain memory
+    bool isSafe( const Instruction& instr ) const;
+    // true if the instruction ends a block
+    static bool isControlFlow( const Instruction& instr );
+
+    CPU* cpu_;
+
+    // blocks by page of 256 bytes, allocated on first use
+    std::vector<Superblock*> pages_[256];
+    // memory the blocks of each page were discovered in
+    const uint8_t* memory_[256];
+    // blocks of the banks switched out, by memory and page
+    typedef std::map<std::pair<const uint8_t*, int>, std::vector<Superblock*> > Parked;
+    Parked parked_;
+    // owned blocks
+    std::vector<Superblock*> blocks_;
+    // marker for addresses that do not start a block
+    Superblock none_;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <thread>
+
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool( int nThreads ) : nThreads_( nThreads ), remaining_( 0 )
+{
+    if ( nThreads_ <= 0 ) {
+        nThreads_ = std::thread::hardware_concurrency();
+    }
+    if ( nThreads_ <= 0 ) {
+        nThreads_ = 1;
+    }
+    for ( int i = 0; i < nThreads_; i++ ) {
+        queues_.push_back( new Queue );
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for ( size_t i = 0; i < queues_.size(); i++ ) {
+        delete queues_[i];
+    }
+}
+
+void ThreadPool::run( const std::vector<Task*>& tasks )
+{
+    if ( tasks.empty() ) {
+        return;
+    }
+    for ( size_t i = 0; i < tasks.size(); i++ ) {
+        queues_[i % nThreads_]->tasks.push_back( tasks[i] );
+    }
+    remaining_ = tasks.size();
+
+    std::vector<std::thread> threads;
+    for ( int i = 1; i < nThreads_; i++ ) {
+        threads.push_back( std::thread( &ThreadPool::work, this, i ) );
+    }
+    // the calling thread is the first worker
+    work( 0 );
+    for ( size_t i = 0; i < threads.size(); i++ ) {
+        threads[i].join();
+    }
+}
+
+void ThreadPool::work( int self )
+{
+    while ( remaining_ > 0 ) {
+        Task* task = take( self );
+        if ( !task ) {
+            // the last tasks are running on other workers
+            std::this_thread::yield();
+            continue;
+        }
+        if ( task->run() ) {
+            Queue& own = *queues_[self];
+            std::lock_guard<std::mutex> guard( own.lock );
+            own.tasks.push_back( task );
+        }
+        else {
+            remaining_--;
+        }
+    }
+}
+
+ThreadPool::Task* ThreadPool::take( int self )
+{
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> guard( own.lock );
+        if ( !own.tasks.empty() ) {
+            Task* task = own.tasks.back();
+            own.tasks.pop_back();
+            return task;
+        }
+    }
+    for ( int i = 1; i < nThreads_; i++ ) {
+        Queue& other = *queues_[(self + i) % nThreads_];
+        std::lock_guard<std::mutex> guard( other.lock );
+        if ( !other.tasks.empty() ) {
+            Task* task = other.tasks.front();
+            other.tasks.pop_front();
+            return task;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef NES_THREAD_POOL_HPP
+#define NES_THREAD_POOL_HPP
+
+#include <stddef.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+///
+/// Worker threads sharing a set of tasks by work stealing
+///
+/// Each worker owns a queue. It runs the task at the back of its own
+/// queue and puts it back there while the task is unfinished, so that a
+/// task tends to stay on the same core. A worker with an empty queue
+/// steals the task at the front of another queue.
+class ThreadPool
+{
+public:
+    /// Unit of work, run again and again until it returns false
+    /// Should return after a short while, to let the load be balanced.
+    class Task
+    {
+    public:
+        virtual ~Task() {}
+        virtual bool run() = 0;
+    };
+
+    /// nThreads: number of workers, 0 for one per hardware thread
+    ThreadPool( int nThreads = 0 );
+    ~ThreadPool();
+
+    int size() const { return nThreads_; }
+
+    /// Run the tasks until all of them are finished
+    /// Tasks are dealt round robin to the workers, they are not owned.
+    void run( const std::vector<Task*>& tasks );
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task*> tasks;
+    };
+
+    void work( int self );
+    // next task for worker self, 0 if all the queues are empty
+    Task* take( int self );
+
+    int nThreads_;
+    std::vector<Queue*> queues_;
+    // unfinished tasks (queued or running)
+    std::atomic<size_t> remaining_;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "tile_decoder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// entry b: byte i is bit (7 - i) of b
+#define SPREAD( b ) \
+    ( (uint64_t( ((b) >> 7) & 1 ))       | (uint64_t( ((b) >> 6) & 1 ) << 8)  | \
+      (uint64_t( ((b) >> 5) & 1 ) << 16) | (uint64_t( ((b) >> 4) & 1 ) << 24) | \
+      (uint64_t( ((b) >> 3) & 1 ) << 32) | (uint64_t( ((b) >> 2) & 1 ) << 40) | \
+      (uint64_t( ((b) >> 1) & 1 ) << 48) | (uint64_t( (b) & 1 ) << 56) )
+#define SPREAD4( b ) SPREAD( b ), SPREAD( b + 1 ), SPREAD( b + 2 ), SPREAD( b + 3 )
+#define SPREAD16( b ) SPREAD4( b ), SPREAD4( b + 4 ), SPREAD4( b + 8 ), SPREAD4( b + 12 )
+#define SPREAD64( b ) SPREAD16( b ), SPREAD16( b + 16 ), SPREAD16( b + 32 ), SPREAD16( b + 48 )
+
+// constant initialized, usable from static constructors
+const uint64_t PatternSpread[256] = { SPREAD64( 0 ), SPREAD64( 64 ), SPREAD64( 128 ), SPREAD64( 192 ) };
+
+#undef SPREAD64
+#undef SPREAD16
+#undef SPREAD4
+#undef SPREAD
+
+void decodePatternScalar( const uint8_t* pattern, uint8_t* out )
+{
+    for ( int y = 0; y < 8; y++ ) {
+        uint8_t low = pattern[y];
+        uint8_t high = pattern[y + 8];
+        for ( int x = 0; x < 8; x++ ) {
+            *out++ = ((low >> (7 - x)) & 1) | (((high >> (7 - x)) & 1) << 1);
+        }
+    }
+}
+
+void decodePatternTable( const uint8_t* pattern, uint8_t* out )
+{
+    for ( int y = 0; y < 8; y++ ) {
+        decodePatternRow( pattern[y], pattern[y + 8], out + y * 8 );
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+namespace
+{
+
+// bytes of a plane, each one replicated 8 times (2 rows per register),
+// reduced to 1 or 0 by testing the bit of the column
+inline __m128i spreadSSE2( __m128i rows, __m128i bits )
+{
+    return _mm_cmpeq_epi8( _mm_and_si128( rows, bits ), bits );
+}
+
+}
+
+void decodePatternSSE2( const uint8_t* pattern, uint8_t* out )
+{
+    const __m128i bits = _mm_set_epi8( 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                       0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80 );
+    const __m128i one = _mm_set1_epi8( 1 );
+    const __m128i two = _mm_set1_epi8( 2 );
+
+    __m128i low = _mm_loadl_epi64( (const __m128i*)pattern );
+    __m128i high = _mm_loadl_epi64( (const __m128i*)(pattern + 8) );
+    // l0 l0 l1 l1 ... then l0 l0 l0 l0 l1 ...
+    __m128i low2 = _mm_unpacklo_epi8( low, low );
+    __m128i high2 = _mm_unpacklo_epi8( high, high );
+    __m128i low4[2] = { _mm_unpacklo_epi16( low2, low2 ), _mm_unpackhi_epi16( low2, low2 ) };
+    __m128i high4[2] = { _mm_unpacklo_epi16( high2, high2 ), _mm_unpackhi_epi16( high2, high2 ) };
+    for ( int i = 0; i < 2; i++ ) {
+        __m128i l[2] = { _mm_unpacklo_epi32( low4[i], low4[i] ), _mm_unpackhi_epi32( low4[i], low4[i] ) };
+        __m128i h[2] = { _mm_unpacklo_epi32( high4[i], high4[i] ), _mm_unpackhi_epi32( high4[i], high4[i] ) };
+        for ( int j = 0; j < 2; j++ ) {
+            __m128i c = _mm_or_si128( _mm_and_si128( spreadSSE2( l[j], bits ), one ),
+                                      _mm_and_si128( spreadSSE2( h[j], bits ), two ) );
+            _mm_storeu_si128( (__m128i*)(out + (i * 2 + j) * 16), c );
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void decodePatternAVX2( const uint8_t* pattern, uint8_t* out )
+{
+    const __m256i bits = _mm256_set1_epi64x( 0x0102040810204080LL );
+    const __m256i one = _mm256_set1_epi8( 1 );
+    const __m256i two = _mm256_set1_epi8( 2 );
+    // byte shuffles stay within 128 bits lanes: rows 0 1 | 2 3, then 4 5 | 6 7
+    const __m256i rows0123 = _mm256_set_epi64x( 0x0303030303030303LL, 0x0202020202020202LL,
+                                                0x0101010101010101LL, 0x0000000000000000LL );
+    const __m256i rows4567 = _mm256_add_epi8( rows0123, _mm256_set1_epi8( 4 ) );
+
+    __m256i low = _mm256_broadcastq_epi64( _mm_loadl_epi64( (const __m128i*)pattern ) );
+    __m256i high = _mm256_broadcastq_epi64( _mm_loadl_epi64( (const __m128i*)(pattern + 8) ) );
+    const __m256i* rows[2] = { &rows0123, &rows4567 };
+    for ( int i = 0; i < 2; i++ ) {
+        __m256i l = _mm256_shuffle_epi8( low, *rows[i] );
+        __m256i h = _mm256_shuffle_epi8( high, *rows[i] );
+        l = _mm256_cmpeq_epi8( _mm256_and_si256( l, bits ), bits );
+        h = _mm256_cmpeq_epi8( _mm256_and_si256( h, bits ), bits );
+        __m256i c = _mm256_or_si256( _mm256_and_si256( l, one ), _mm256_and_si256( h, two ) );
+        _mm256_storeu_si256( (__m256i*)(out + i * 32), c );
+    }
+}
+
+#endif
+
+namespace
+{
+
+struct Selected
+{
+    PatternDecoder decoder;
+    const char* name;
+    Selected()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) ) {
+            decoder = decodePatternAVX2;
+            name = "avx2";
+            return;
+        }
+        if ( __builtin_cpu_supports( "sse2" ) ) {
+            decoder = decodePatternSSE2;
+            name = "sse2";
+            return;
+        }
+#endif
+        decoder = decodePatternTable;
+        name = "table";
+    }
+};
+
+}
+
+static const Selected selected;
+
+void decodePattern( const uint8_t* pattern, uint8_t* out )
+{
+    selected.decoder( pattern, out );
+}
+
+const char* patternDecoderName()
+{
+    return selected.name;
+}
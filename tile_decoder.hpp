@@ -0,0 +1,46 @@
+#ifndef NES_TILE_DECODER_HPP
+#define NES_TILE_DECODER_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+///
+/// Decoding of CHR patterns
+///
+/// A pattern row is stored as two bitplanes: the byte of the low bits of
+/// the 8 pixels, and 8 bytes further, the byte of the high bits. The
+/// leftmost pixel is the most significant bit.
+
+/// Bits of a plane spread to bytes: byte i of entry b is bit (7 - i) of b
+extern const uint64_t PatternSpread[256];
+
+/// Decode a pattern row into 8 color indices (0 to 3), leftmost first.
+inline void decodePatternRow( uint8_t low, uint8_t high, uint8_t* out )
+{
+    uint64_t v = PatternSpread[low] | (PatternSpread[high] << 1);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy( out, &v, 8 );
+#else
+    for ( int i = 0; i < 8; i++ ) {
+        out[i] = v >> (i * 8);
+    }
+#endif
+}
+
+/// Decode a whole 8x8 pattern (16 bytes) into 64 color indices, row by row.
+/// Uses AVX2 or SSE2 when available.
+void decodePattern( const uint8_t* pattern, uint8_t* out );
+
+/// Implementations of decodePattern, for tests and benchmarks
+typedef void (*PatternDecoder)( const uint8_t* pattern, uint8_t* out );
+void decodePatternScalar( const uint8_t* pattern, uint8_t* out );
+void decodePatternTable( const uint8_t* pattern, uint8_t* out );
+#if defined(__x86_64__) || defined(__i386__)
+void decodePatternSSE2( const uint8_t* pattern, uint8_t* out );
+void decodePatternAVX2( const uint8_t* pattern, uint8_t* out );
+#endif
+
+/// name of the implementation used by decodePattern
+const char* patternDecoderName();
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+namespace
+{
+
+double monotonicNs()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// nearest rank, values sorted
+uint64_t percentile( const std::vector<uint64_t>& values, double p )
+{
+    if ( values.empty() ) {
+        return 0;
+    }
+    size_t rank = size_t( p * values.size() + 0.999999 );
+    return values[std::min( std::max( rank, size_t( 1 ) ), values.size() ) - 1];
+}
+
+}
+
+Tracer Tracer::instance_;
+
+Tracer::Tracer() : enabled_( false ),
+                   startTicks_( 0 ),
+                   startNs_( 0 ),
+                   last_( 0 ),
+                   frameStart_( 0 )
+{
+    memset( components_, 0, sizeof(components_) );
+}
+
+bool Tracer::compiled()
+{
+#ifdef NES_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Tracer::setEnabled( bool enabled )
+{
+    enabled_ = enabled;
+    if ( enabled_ ) {
+        startTicks_ = now();
+        startNs_ = monotonicNs();
+        frameStart_ = startTicks_;
+        memset( components_, 0, sizeof(components_) );
+    }
+}
+
+double Tracer::nsPerTick() const
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ticks = now() - startTicks_;
+    double ns = monotonicNs() - startNs_;
+    return ticks ? ns / ticks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+void Tracer::endFrame()
+{
+    if ( !enabled_ ) {
+        return;
+    }
+    uint64_t t = now();
+    // the open scopes go on in the next frame
+    if ( !open_.empty() ) {
+        components_[open_.back().component] += t - last_;
+        last_ = t;
+    }
+    Frame frame;
+    frame.start = frameStart_;
+    frame.duration = t - frameStart_;
+    memcpy( frame.components, components_, sizeof(components_) );
+    frames_.push_back( frame );
+    memset( components_, 0, sizeof(components_) );
+    frameStart_ = t;
+}
+
+void Tracer::writeChromeTrace( std::ostream& ostr ) const
+{
+    double scale = nsPerTick() / 1000;
+    char line[160];
+    ostr << "{\"traceEvents\":[" << std::endl;
+    ostr << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"frames\"}}," << std::endl;
+    ostr << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"components\"}}";
+    for ( size_t i = 0; i < frames_.size(); i++ ) {
+        const Frame& f = frames_[i];
+        snprintf( line, sizeof(line),
+                  ",\n{\"name\":\"frame %d\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                  int( i ), (f.start - startTicks_) * scale, f.duration * scale );
+        ostr << line;
+    }
+    for ( size_t i = 0; i < events_.size(); i++ ) {
+        const Event& e = events_[i];
+        snprintf( line, sizeof(line),
+                  ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+                  componentName( e.component ), (e.start - startTicks_) * scale, e.duration * scale );
+        ostr << line;
+    }
+    ostr << "\n]," << std::endl;
+    ostr << "\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+void Tracer::writeSummary( std::ostream& ostr ) const
+{
+    double scale = nsPerTick() / 1e6;
+    char line[160];
+    std::vector<uint64_t> values( frames_.size() );
+    for ( size_t i = 0; i < frames_.size(); i++ ) {
+        values[i] = frames_[i].duration;
+    }
+    std::sort( values.begin(), values.end() );
+    snprintf( line, sizeof(line), "%-10s %10s %10s %10s %10s", "ms", "mean", "p50", "p99", "max" );
+    ostr << frames_.size() << " frames" << std::endl << line << std::endl;
+
+    for ( int c = -1; c < NComponents; c++ ) {
+        if ( c >= 0 ) {
+            for ( size_t i = 0; i < frames_.size(); i++ ) {
+                values[i] = frames_[i].components[c];
+            }
+            std::sort( values.begin(), values.end() );
+        }
+        uint64_t total = 0;
+        for ( size_t i = 0; i < values.size(); i++ ) {
+            total += values[i];
+        }
+        if ( c >= 0 && !total ) {
+            continue;
+        }
+        snprintf( line, sizeof(line), "%-10s %10.3f %10.3f %10.3f %10.3f",
+                  c < 0 ? "frame" : componentName( Component( c ) ),
+                  values.empty() ? 0.0 : total * scale / values.size(),
+                  percentile( values, 0.5 ) * scale, percentile( values, 0.99 ) * scale,
+                  (values.empty() ? 0 : values.back()) * scale );
+        ostr << line << std::endl;
+    }
+    if ( events_.size() >= MaxEvents ) {
+        ostr << "trace truncated to " << MaxEvents << " events" << std::endl;
+    }
+}
+
+const char* Tracer::componentName( Component component )
+{
+    switch ( component )
+    {
+    case Cpu:
+        return "cpu";
+    case CpuDebug:
+        return "cpu_debug";
+    case Ppu:
+        return "ppu";
+    case Render:
+        return "render";
+    case Present:
+        return "present";
+    case Apu:
+        return "apu";
+    case Poll:
+        return "poll";
+    case Debugger:
+        return "debugger";
+    case Rewind:
+        return "rewind";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,175 @@
+#ifndef NES_TRACE_HPP
+#define NES_TRACE_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+///
+/// Where the host time goes, per component and per frame
+///
+/// The components mark their work with NES_TRACE_SCOPE, a timer that
+/// reads the time stamp counter on entry and on exit. The time is
+/// exclusive: a component called from another one (the PPU caught up
+/// during a CPU instruction) is not counted in its caller. Each frame
+/// keeps the time of each component, for the percentiles, and the scopes
+/// are kept as events for the Chrome trace viewer (chrome://tracing,
+/// ui.perfetto.dev).
+///
+/// The timers are only compiled with NES_TRACE defined (cmake
+/// -DNES_TRACE=ON), NES_TRACE_SCOPE is empty otherwise.
+class Tracer
+{
+public:
+    enum Component
+    {
+        // runFrame, release or profile policy
+        Cpu,
+        // runFrame, debug policy
+        CpuDebug,
+        // PPU catching up, tick by tick or skipping
+        Ppu,
+        // PPU scanline renderer
+        Render,
+        // frame handed to the frontend
+        Present,
+        // APU synthesis and audio output
+        Apu,
+        // host events
+        Poll,
+        // instructions run one at a time by the debugger
+        Debugger,
+        Rewind,
+        NComponents
+    };
+
+    static Tracer& instance() { return instance_; }
+
+    /// true if the timers are compiled in
+    static bool compiled();
+
+    /// Start measuring, nothing is recorded before
+    void setEnabled( bool enabled );
+    bool enabled() const { return enabled_; }
+
+    /// Time stamp, in ticks
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return uint64_t( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+#endif
+    }
+
+    /// Scope of component entered, see TraceScope
+    void enter( Component component )
+    {
+        if ( !enabled_ ) {
+            return;
+        }
+        uint64_t t = now();
+        if ( !open_.empty() ) {
+            components_[open_.back().component] += t - last_;
+        }
+        Open open = { component, t };
+        open_.push_back( open );
+        last_ = t;
+    }
+    void leave()
+    {
+        if ( open_.empty() ) {
+            return;
+        }
+        uint64_t t = now();
+        const Open& open = open_.back();
+        components_[open.component] += t - last_;
+        last_ = t;
+        if ( t - open.start >= MinEventTicks && events_.size() < MaxEvents ) {
+            Event event = { open.start, t - open.start, open.component };
+            events_.push_back( event );
+        }
+        open_.pop_back();
+    }
+
+    /// To be called by the host once per frame
+    void endFrame();
+
+    /// Chrome trace event JSON: the scopes, and the frames on their own row
+    void writeChromeTrace( std::ostream& ostr ) const;
+    /// p50, p99 and max of the frame time and of each component
+    void writeSummary( std::ostream& ostr ) const;
+
+    static const char* componentName( Component component );
+
+private:
+    Tracer();
+
+    static Tracer instance_;
+
+    // shorter scopes are only counted in the frame times
+    // (about a microsecond at a few GHz)
+    static const uint64_t MinEventTicks = 2000;
+    static const size_t MaxEvents = 1 << 20;
+
+    struct Open
+    {
+        Component component;
+        uint64_t start;
+    };
+    struct Event
+    {
+        uint64_t start;
+        uint64_t duration;
+        Component component;
+    };
+    struct Frame
+    {
+        uint64_t start;
+        uint64_t duration;
+        uint64_t components[NComponents];
+    };
+
+    // nanoseconds per tick, measured against the monotonic clock since
+    // setEnabled
+    double nsPerTick() const;
+
+    bool enabled_;
+    // clocks when enabled
+    uint64_t startTicks_;
+    double startNs_;
+
+    std::vector<Open> open_;
+    // last enter or leave
+    uint64_t last_;
+    // time of each component in the current frame
+    uint64_t components_[NComponents];
+    uint64_t frameStart_;
+
+    std::vector<Event> events_;
+    std::vector<Frame> frames_;
+};
+
+///
+/// Scoped timer, see NES_TRACE_SCOPE
+class TraceScope
+{
+public:
+    TraceScope( Tracer::Component component ) { Tracer::instance().enter( component ); }
+    ~TraceScope() { Tracer::instance().leave(); }
+};
+
+#ifdef NES_TRACE
+#define NES_TRACE_SCOPE( component ) TraceScope traceScope( Tracer::component )
+#else
+#define NES_TRACE_SCOPE( component )
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#include <string.h>
+
+#include "watchpoints.hpp"
+
+Watchpoints::Watchpoints()
+{
+    memset( bits_, 0, sizeof(bits_) );
+    memset( counts_, 0, sizeof(counts_) );
+}
+
+void Watchpoints::add( Kind kind, uint16_t first, uint16_t last )
+{
+    if ( last < first ) {
+        uint16_t t = first;
+        first = last;
+        last = t;
+    }
+    Range range;
+    range.kind = kind;
+    range.first = first;
+    range.last = last;
+    range.hits = 0;
+    ranges_.push_back( range );
+    counts_[kind]++;
+    for ( uint32_t a = first; a <= last; a++ ) {
+        bits_[kind][a >> 6] |= uint64_t( 1 ) << (a & 63);
+    }
+}
+
+void Watchpoints::remove( Kind kind, uint16_t first, uint16_t last )
+{
+    if ( last < first ) {
+        uint16_t t = first;
+        first = last;
+        last = t;
+    }
+    size_t n = 0;
+    for ( size_t i = 0; i < ranges_.size(); i++ ) {
+        const Range& r = ranges_[i];
+        if ( r.kind == kind && r.first >= first && r.last <= last ) {
+            counts_[kind]--;
+            continue;
+        }
+        ranges_[n++] = r;
+    }
+    ranges_.resize( n );
+    rebuild( kind );
+}
+
+void Watchpoints::rebuild( Kind kind )
+{
+    // ranges may overlap, set the bits of all the remaining ones again
+    memset( bits_[kind], 0, sizeof(bits_[kind]) );
+    for ( size_t i = 0; i < ranges_.size(); i++ ) {
+        const Range& r = ranges_[i];
+        if ( r.kind != kind ) {
+            continue;
+        }
+        for ( uint32_t a = r.first; a <= r.last; a++ ) {
+            bits_[kind][a >> 6] |= uint64_t( 1 ) << (a & 63);
+        }
+    }
+}
+
+void Watchpoints::hit( Kind kind, uint16_t addr ) const
+{
+    for ( size_t i = 0; i < ranges_.size(); i++ ) {
+        const Range& r = ranges_[i];
+        if ( r.kind == kind && addr >= r.first && addr <= r.last ) {
+            r.hits++;
+        }
+    }
+}
+
+const char* Watchpoints::kindName( Kind kind )
+{
+    switch ( kind )
+    {
+    case Read:
+        return "read";
+    case Write:
+        return "write";
+    case Execute:
+        return "execute";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef NES_WATCHPOINTS_HPP
+#define NES_WATCHPOINTS_HPP
+
+#include <stdint.h>
+#include <vector>
+
+///
+/// Breakpoints and watches of the debugger
+///
+/// Each kind of access has a bitmap of the 64K addresses of the CPU bus,
+/// so that checking an access is a single bit test, whatever the number
+/// of ranges watched. The ranges themselves are kept beside, with their
+/// hit counters, for the listing and the removal.
+class Watchpoints
+{
+public:
+    enum Kind
+    {
+        Read,
+        Write,
+        Execute,
+        NKinds
+    };
+
+    struct Range
+    {
+        Kind kind;
+        uint16_t first;
+        uint16_t last;
+        // accesses that stopped the emulation
+        mutable uint64_t hits;
+    };
+
+    Watchpoints();
+
+    /// Watch [first, last]
+    void add( Kind kind, uint16_t first, uint16_t last );
+    /// Stop watching the ranges of kind within [first, last]
+    void remove( Kind kind, uint16_t first, uint16_t last );
+    void clear( Kind kind ) { remove( kind, 0x0000, 0xFFFF ); }
+
+    bool test( Kind kind, uint16_t addr ) const
+    {
+        return (bits_[kind][addr >> 6] >> (addr & 63)) & 1;
+    }
+    /// true if some address is watched for kind
+    bool any( Kind kind ) const { return counts_[kind] != 0; }
+    /// true if anything is watched
+    bool active() const { return counts_[Read] || counts_[Write] || counts_[Execute]; }
+
+    /// Count a hit on addr in the ranges containing it
+    void hit( Kind kind, uint16_t addr ) const;
+
+    const std::vector<Range>& ranges() const { return ranges_; }
+
+    static const char* kindName( Kind kind );
+
+private:
+    // bits of the ranges of kind
+    void rebuild( Kind kind );
+
+    uint64_t bits_[NKinds][0x10000 / 64];
+    // ranges of each kind
+    int counts_[NKinds];
+    std::vector<Range> ranges_;
+};
+
+#endif